@@ -8,7 +8,9 @@
 LOG_MODULE_REGISTER(gsm_mux, CONFIG_GSM_MUX_LOG_LEVEL);
 
 #include <zephyr/kernel.h>
+#include <zephyr/drivers/uart.h>
 #include <zephyr/sys/util.h>
+#include <zephyr/sys/byteorder.h>
 #include <zephyr/sys/crc.h>
 #include <zephyr/net/buf.h>
 #include <zephyr/net/ppp.h>
@@ -23,6 +25,29 @@ LOG_MODULE_REGISTER(gsm_mux, CONFIG_GSM_MUX_LOG_LEVEL);
 #define N1 256 /* default I frame size, GSM 07.10 ch 6.2.2.1 */
 #define N2 3   /* retry 3 times */
 
+/* Limits for the adaptive T1/T2 values. The timers are derived from the
+ * measured round trip times the same way TCP derives its RTO (RFC 6298).
+ */
+#if defined(CONFIG_GSM_MUX_ADAPTIVE_TIMERS)
+#define TIMER_MIN_MSEC CONFIG_GSM_MUX_TIMER_MIN
+#define TIMER_MAX_MSEC CONFIG_GSM_MUX_TIMER_MAX
+#define PROBE_INTERVAL_MSEC CONFIG_GSM_MUX_PROBE_INTERVAL
+#else
+#define TIMER_MIN_MSEC T1_MSEC
+#define TIMER_MAX_MSEC UINT16_MAX
+#define PROBE_INTERVAL_MSEC 0
+#endif
+#define TIMER_GRANULARITY_MSEC 10 /* T1 resolution, GSM 07.10 ch 5.7.1 */
+
+/* Error recovery mode, N(S) and N(R) are modulo 8, GSM 07.10 ch 6.2 */
+#define ERM_MASK      0x07
+#define ERM_NS(ctrl)  (((ctrl) & 0x0E) >> 1)
+#define ERM_NR(ctrl)  (((ctrl) & 0xE0) >> 5)
+#define ERM_FRAME_OVERHEAD 7 /* flags, address, control, length and FCS */
+#if defined(CONFIG_GSM_MUX_ERROR_RECOVERY)
+#define ERM_WINDOW    CONFIG_GSM_MUX_ERROR_RECOVERY_WINDOW
+#endif
+
 /* CRC8 is the reflected CRC8/ROHC algorithm */
 #define FCS_POLYNOMIAL 0xe0 /* reversed crc8 */
 #define FCS_INIT_VALUE 0xFF
@@ -56,6 +81,11 @@ LOG_MODULE_REGISTER(gsm_mux, CONFIG_GSM_MUX_LOG_LEVEL);
 #define CMD_SNC    0x68  /* Service Negotiation Command              */
 #define CMD_MSC    0x70  /* Modem Status Command                     */
 
+/* DLC parameter negotiation values, GSM 07.10 ch 5.4.6.3.1 */
+#define PN_LEN       8
+#define PN_FRAME_UIH 0x00
+#define PN_FRAME_I   0x02
+
 /* Flag sequence field between messages (start of frame) */
 #define SOF_MARKER 0xF9
 
@@ -68,7 +98,15 @@ enum gsm_mux_state {
 	GSM_MUX_LEN_1,    /* Second length byte   */
 	GSM_MUX_DATA,     /* Data                 */
 	GSM_MUX_FCS,      /* Frame Check Sequence */
-	GSM_MUX_EOF       /* End of frame         */
+	GSM_MUX_EOF,      /* End of frame         */
+	GSM_MUX_RESYNC    /* Lost sync, scanning  */
+};
+
+/* Round trip time estimator, values are scaled like in RFC 6298 */
+struct gsm_mux_rtt {
+	uint32_t srtt;   /* smoothed RTT, in 1/8 ms */
+	uint32_t rttvar; /* RTT variation, in 1/4 ms */
+	bool valid : 1;
 };
 
 struct gsm_mux {
@@ -77,6 +115,9 @@ struct gsm_mux {
 	 */
 	const struct device *uart;
 
+	/* Used instead of the UART if set, see gsm_mux_create_transport() */
+	const struct gsm_mux_transport *transport;
+
 	/* Buf to use when TX mux packet (hdr + data). For RX it only contains
 	 * the data (not hdr).
 	 */
@@ -94,8 +135,25 @@ struct gsm_mux {
 	struct k_work_delayable t2_timer;
 	sys_slist_t pending_ctrls;
 
-	uint16_t t1_timeout_value; /* T1 default value */
-	uint16_t t2_timeout_value; /* T2 default value */
+	/* Sends CMD_TEST when the link has been idle to keep RTT fresh */
+	struct k_work_delayable probe_timer;
+
+	uint16_t t1_timeout_value; /* T1 current value */
+	uint16_t t2_timeout_value; /* T2 current value */
+
+	struct gsm_mux_rtt t1_rtt; /* SABM/DISC -> UA round trips */
+	struct gsm_mux_rtt t2_rtt; /* control command -> response round trips */
+	uint32_t rtt_samples;
+	uint32_t rtt_hist[GSM_MUX_RTT_HIST_LEN];
+	uint32_t last_rx;          /* uptime of the last received data */
+
+	struct gsm_mux_stats stats;
+	uint32_t fcoff_start;      /* uptime when FCOFF was received */
+
+#if defined(CONFIG_GSM_MUX_ERROR_RECOVERY)
+	/* Window negotiated with PN by DLCI address, 0 for UIH frames */
+	uint8_t erm_window[64];
+#endif
 
 	/* Information from currently read packet */
 	uint8_t address;      /* dlci address (only one byte address supported) */
@@ -105,6 +163,7 @@ struct gsm_mux {
 	uint8_t retries;      /* N2 counter */
 
 	bool in_use : 1;
+	bool fcoff : 1;          /* Peer does not accept data */
 	bool is_initiator : 1;   /* Did we initiate the connection attempt */
 	bool refuse_service : 1; /* Do not try to talk to this modem */
 };
@@ -139,7 +198,23 @@ struct gsm_dlci {
 	enum gsm_dlci_mode mode;
 	int num;
 	uint32_t req_start;
+	struct gsm_dlci_stats stats;
 	uint8_t retries;
+#if defined(CONFIG_GSM_MUX_ERROR_RECOVERY)
+	/* Error recovery mode state, GSM 07.10 ch 6 */
+	struct k_mutex erm_lock;
+	struct k_work_delayable erm_timer;       /* acknowledgement timer */
+	sys_slist_t erm_tx_queue;                /* frames waiting for window */
+	struct net_buf *erm_unacked[ERM_MASK + 1]; /* sent frames by N(S) */
+	uint8_t vs;          /* V(S), N(S) of the next frame to send */
+	uint8_t va;          /* V(A), oldest unacknowledged N(S) */
+	uint8_t vr;          /* V(R), N(S) of the next expected frame */
+	uint32_t erm_t1;     /* acknowledgement timeout in ms */
+	uint8_t erm_retries; /* N2 counter for the acknowledgement timer */
+	uint8_t erm_window;  /* k, data is sent in I frames if non zero */
+	bool peer_busy : 1;  /* RNR received */
+	bool rej_sent : 1;   /* REJ sent, waiting for the retransmission */
+#endif
 	bool refuse_service : 1; /* Do not try to talk to this channel */
 	bool in_use : 1;
 };
@@ -149,6 +224,7 @@ struct gsm_control_msg {
 	struct net_buf *buf;
 	uint32_t req_start;
 	uint8_t cmd;
+	uint8_t retries;
 	bool finished : 1;
 };
 
@@ -162,6 +238,12 @@ struct gsm_control_msg {
 
 NET_BUF_POOL_DEFINE(gsm_mux_pool, MIN_BUF_COUNT, MAX_MRU, 0, NULL);
 
+#if defined(CONFIG_GSM_MUX_ERROR_RECOVERY)
+/* I frames are kept here until the peer has acknowledged them */
+NET_BUF_POOL_DEFINE(gsm_erm_pool, CONFIG_GSM_MUX_ERROR_RECOVERY_BUFS, MAX_MRU,
+		    0, NULL);
+#endif
+
 #define BUF_ALLOC_TIMEOUT K_MSEC(50)
 
 static struct gsm_mux muxes[CONFIG_GSM_MUX_MAX];
@@ -334,7 +416,14 @@ static int gsm_dlci_process_data(struct gsm_dlci *dlci, bool cmd,
 	hexdump_buf("buf", buf);
 
 	while (buf) {
-		uart_mux_recv(dlci->uart, dlci, buf->data, buf->len);
+		if (dlci->mux->transport) {
+			dlci->mux->transport->recv(dlci->mux, dlci->num,
+						   buf->data, buf->len,
+						   dlci->mux->transport->user_data);
+		} else {
+			uart_mux_recv(dlci->uart, dlci, buf->data, buf->len);
+		}
+
 		len += buf->len;
 		buf = buf->frags;
 	}
@@ -359,7 +448,7 @@ static struct gsm_dlci *gsm_dlci_get(struct gsm_mux *mux, uint8_t dlci_address)
 
 static int gsm_mux_modem_send(struct gsm_mux *mux, const uint8_t *buf, size_t size)
 {
-	if (mux->uart == NULL) {
+	if (mux->uart == NULL && mux->transport == NULL) {
 		return -ENOENT;
 	}
 
@@ -367,6 +456,11 @@ static int gsm_mux_modem_send(struct gsm_mux *mux, const uint8_t *buf, size_t si
 		return 0;
 	}
 
+	if (mux->transport) {
+		return mux->transport->send(mux, buf, size,
+					    mux->transport->user_data);
+	}
+
 	return uart_mux_send(mux->uart, buf, size);
 }
 
@@ -375,6 +469,7 @@ static int gsm_mux_send_data_msg(struct gsm_mux *mux, bool cmd,
 				 const uint8_t *buf, size_t size)
 {
 	uint8_t hdr[7];
+	uint8_t fcs;
 	int pos;
 	int ret;
 
@@ -401,18 +496,24 @@ static int gsm_mux_send_data_msg(struct gsm_mux *mux, bool cmd,
 	}
 
 	/* FSC is calculated only for address, type and length fields
-	 * for UIH frames
+	 * for UIH frames, and over the data too for the others
 	 */
-	hdr[pos] = 0xFF - gsm_mux_fcs_add_buf(FCS_INIT_VALUE, &hdr[1],
-					      pos - 1);
+	fcs = gsm_mux_fcs_add_buf(FCS_INIT_VALUE, &hdr[1], pos - 1);
 	if ((frame_type & ~GSM_PF) != FT_UIH) {
-		hdr[pos] = gsm_mux_fcs_add_buf(hdr[pos], buf, size);
+		fcs = gsm_mux_fcs_add_buf(fcs, buf, size);
 	}
 
+	hdr[pos] = 0xFF - fcs;
+
 	hdr[pos + 1] = SOF_MARKER;
 
 	ret = gsm_mux_modem_send(mux, &hdr[pos], 2);
 
+	mux->stats.tx_frames++;
+	mux->stats.tx_bytes += size;
+	dlci->stats.tx_frames++;
+	dlci->stats.tx_bytes += size;
+
 	hexdump_packet("Sending", dlci->num, cmd, frame_type,
 		       buf, size);
 	return ret;
@@ -433,6 +534,12 @@ static int gsm_mux_send_control_msg(struct gsm_mux *mux, bool cmd,
 	hexdump_packet("Sending", dlci_address, cmd, frame_type,
 		       buf, sizeof(buf));
 
+	mux->stats.tx_frames++;
+
+	if ((frame_type & ~GSM_PF) == FT_DM) {
+		mux->stats.dlci_refused++;
+	}
+
 	return gsm_mux_modem_send(mux, buf, sizeof(buf));
 }
 
@@ -448,6 +555,448 @@ static int gsm_mux_send_response(struct gsm_mux *mux, uint8_t dlci_address,
 	return gsm_mux_send_control_msg(mux, false, dlci_address, frame_type);
 }
 
+static uint16_t gsm_mux_rtt_update(struct gsm_mux *mux, struct gsm_mux_rtt *rtt,
+				   uint32_t sample)
+{
+	uint32_t rto;
+	int32_t delta;
+	int idx;
+
+	idx = MIN(find_msb_set(sample), GSM_MUX_RTT_HIST_LEN - 1);
+	mux->rtt_hist[idx]++;
+	mux->rtt_samples++;
+
+	if (!rtt->valid) {
+		rtt->srtt = sample << 3;
+		rtt->rttvar = sample << 1;
+		rtt->valid = true;
+	} else {
+		delta = (int32_t)sample - (int32_t)(rtt->srtt >> 3);
+		rtt->srtt += delta;
+
+		if (delta < 0) {
+			delta = -delta;
+		}
+
+		rtt->rttvar += delta - (rtt->rttvar >> 2);
+	}
+
+	/* RTO = SRTT + max(G, 4 * RTTVAR) */
+	rto = (rtt->srtt >> 3) + MAX(TIMER_GRANULARITY_MSEC, rtt->rttvar);
+
+	return CLAMP(rto, TIMER_MIN_MSEC, TIMER_MAX_MSEC);
+}
+
+/* T2 must be longer than T1, GSM 07.10 ch 5.7.4 */
+static uint16_t gsm_mux_t2_min(struct gsm_mux *mux)
+{
+	return MIN(mux->t1_timeout_value + TIMER_GRANULARITY_MSEC,
+		   TIMER_MAX_MSEC);
+}
+
+static void gsm_mux_t1_sample(struct gsm_mux *mux, uint32_t sample)
+{
+	uint16_t rto = gsm_mux_rtt_update(mux, &mux->t1_rtt, sample);
+
+	LOG_DBG("[%p] T1 RTT %u ms, RTO %u ms", mux, sample, rto);
+
+	if (IS_ENABLED(CONFIG_GSM_MUX_ADAPTIVE_TIMERS)) {
+		mux->t1_timeout_value = rto;
+		mux->t2_timeout_value = MAX(mux->t2_timeout_value,
+					    gsm_mux_t2_min(mux));
+	}
+}
+
+static void gsm_mux_t2_sample(struct gsm_mux *mux, uint32_t sample)
+{
+	uint16_t rto = gsm_mux_rtt_update(mux, &mux->t2_rtt, sample);
+
+	LOG_DBG("[%p] T2 RTT %u ms, RTO %u ms", mux, sample, rto);
+
+	if (IS_ENABLED(CONFIG_GSM_MUX_ADAPTIVE_TIMERS)) {
+		mux->t2_timeout_value = MAX(rto, gsm_mux_t2_min(mux));
+	}
+}
+
+/* Exponential backoff when a timer expires, like TCP does for the RTO */
+static void gsm_mux_timer_backoff(uint16_t *timeout_value)
+{
+	if (IS_ENABLED(CONFIG_GSM_MUX_ADAPTIVE_TIMERS)) {
+		*timeout_value = MIN(*timeout_value * 2, TIMER_MAX_MSEC);
+	}
+}
+
+static int gsm_dlci_closing(struct gsm_dlci *dlci, dlci_command_cb_t cb);
+#if defined(CONFIG_GSM_MUX_ERROR_RECOVERY)
+static void gsm_dlci_pn_done(struct gsm_mux *mux, uint8_t address,
+			     struct net_buf *rsp);
+#endif
+
+static bool gsm_dlci_is_erm(struct gsm_dlci *dlci)
+{
+#if defined(CONFIG_GSM_MUX_ERROR_RECOVERY)
+	return dlci->erm_window > 0;
+#else
+	ARG_UNUSED(dlci);
+
+	return false;
+#endif
+}
+
+static bool gsm_mux_is_erm_frame(uint8_t control)
+{
+	switch (control & 0x0F) {
+	case FT_RR:
+	case FT_RNR:
+	case FT_REJ:
+		return true;
+	}
+
+	/* I frames have the lowest bit cleared */
+	return !(control & 0x01);
+}
+
+#if defined(CONFIG_GSM_MUX_ERROR_RECOVERY)
+/* Line rate in bit/s, 0 if it is not known */
+static uint32_t gsm_mux_line_rate(struct gsm_mux *mux)
+{
+	if (mux->transport) {
+		return mux->transport->baudrate;
+	}
+
+#if defined(CONFIG_UART_USE_RUNTIME_CONFIGURE)
+	struct uart_config cfg;
+
+	if (mux->uart && uart_config_get(mux->uart, &cfg) == 0) {
+		return cfg.baudrate;
+	}
+#endif
+
+	return 0;
+}
+
+/* The mux T1 comes from SABM/DISC round trips, an I frame can wait for
+ * a full window of N1 sized frames on the line before it is acknowledged.
+ */
+static uint32_t gsm_dlci_erm_t1(struct gsm_dlci *dlci)
+{
+	uint32_t rate = gsm_mux_line_rate(dlci->mux);
+	uint32_t t1 = dlci->mux->t1_timeout_value;
+
+	if (rate > 0) {
+		/* 10 bits per byte with the start and stop bits */
+		t1 += DIV_ROUND_UP(dlci->erm_window *
+				   (dlci->mux->mru + ERM_FRAME_OVERHEAD) *
+				   10U * MSEC_PER_SEC, rate);
+	}
+
+	return t1;
+}
+
+static int gsm_dlci_erm_send_supervisory(struct gsm_dlci *dlci, bool cmd,
+					 uint8_t frame_type, bool pf)
+{
+	return gsm_mux_send_control_msg(dlci->mux, cmd, dlci->num,
+					frame_type | (dlci->vr << 5) |
+					(pf ? GSM_PF : 0));
+}
+
+static void gsm_dlci_erm_send_frame(struct gsm_dlci *dlci, uint8_t ns)
+{
+	struct net_buf *frame = dlci->erm_unacked[ns];
+
+	/* The receive state is piggybacked in the N(R) field */
+	(void)gsm_mux_send_data_msg(dlci->mux, true, dlci,
+				    (ns << 1) | (dlci->vr << 5),
+				    frame->data, frame->len);
+
+	if (!k_work_delayable_is_pending(&dlci->erm_timer)) {
+		k_work_reschedule(&dlci->erm_timer, K_MSEC(dlci->erm_t1));
+	}
+}
+
+/* Send queued frames as long as the window allows. Returns the number of
+ * frames sent. Must be called with erm_lock held.
+ */
+static int gsm_dlci_erm_kick(struct gsm_dlci *dlci)
+{
+	struct net_buf *frame;
+	sys_snode_t *node;
+	int count = 0;
+
+	while (!dlci->peer_busy &&
+	       ((dlci->vs - dlci->va) & ERM_MASK) < dlci->erm_window) {
+		node = sys_slist_get(&dlci->erm_tx_queue);
+		if (!node) {
+			break;
+		}
+
+		/* The list node shares storage with the fragment pointer */
+		frame = CONTAINER_OF(node, struct net_buf, node);
+		frame->frags = NULL;
+
+		dlci->erm_unacked[dlci->vs] = frame;
+		gsm_dlci_erm_send_frame(dlci, dlci->vs);
+		dlci->vs = (dlci->vs + 1) & ERM_MASK;
+		count++;
+	}
+
+	return count;
+}
+
+/* Go back N, resend everything that is not acknowledged yet */
+static void gsm_dlci_erm_retransmit(struct gsm_dlci *dlci)
+{
+	uint8_t ns;
+
+	for (ns = dlci->va; ns != dlci->vs; ns = (ns + 1) & ERM_MASK) {
+		dlci->stats.retransmissions++;
+		gsm_dlci_erm_send_frame(dlci, ns);
+	}
+}
+
+/* Release the frames acknowledged by the received N(R) */
+static void gsm_dlci_erm_ack(struct gsm_dlci *dlci, uint8_t nr)
+{
+	bool acked = false;
+
+	/* N(R) must be within V(A) .. V(S) */
+	if (((nr - dlci->va) & ERM_MASK) > ((dlci->vs - dlci->va) & ERM_MASK)) {
+		LOG_DBG("[%p] DLCI %d invalid N(R) %d", dlci->mux, dlci->num,
+			nr);
+		return;
+	}
+
+	while (dlci->va != nr) {
+		net_buf_unref(dlci->erm_unacked[dlci->va]);
+		dlci->erm_unacked[dlci->va] = NULL;
+		dlci->va = (dlci->va + 1) & ERM_MASK;
+		acked = true;
+	}
+
+	if (!acked) {
+		return;
+	}
+
+	/* Progress, drop the backoff */
+	dlci->erm_retries = dlci->mux->retries;
+	dlci->erm_t1 = gsm_dlci_erm_t1(dlci);
+
+	if (dlci->va == dlci->vs) {
+		(void)k_work_cancel_delayable(&dlci->erm_timer);
+	} else {
+		k_work_reschedule(&dlci->erm_timer, K_MSEC(dlci->erm_t1));
+	}
+}
+
+static void gsm_dlci_erm_free_list(sys_slist_t *list)
+{
+	struct net_buf *frame;
+	sys_snode_t *node;
+
+	while ((node = sys_slist_get(list)) != NULL) {
+		frame = CONTAINER_OF(node, struct net_buf, node);
+		frame->frags = NULL;
+		net_buf_unref(frame);
+	}
+}
+
+static void gsm_dlci_erm_reset(struct gsm_dlci *dlci)
+{
+	int i;
+
+	k_mutex_lock(&dlci->erm_lock, K_FOREVER);
+
+	(void)k_work_cancel_delayable(&dlci->erm_timer);
+
+	gsm_dlci_erm_free_list(&dlci->erm_tx_queue);
+
+	for (i = 0; i < ARRAY_SIZE(dlci->erm_unacked); i++) {
+		if (dlci->erm_unacked[i]) {
+			net_buf_unref(dlci->erm_unacked[i]);
+			dlci->erm_unacked[i] = NULL;
+		}
+	}
+
+	dlci->vs = 0;
+	dlci->va = 0;
+	dlci->vr = 0;
+	dlci->erm_retries = dlci->mux->retries;
+	dlci->erm_t1 = gsm_dlci_erm_t1(dlci);
+	dlci->peer_busy = false;
+	dlci->rej_sent = false;
+
+	k_mutex_unlock(&dlci->erm_lock);
+}
+
+/* Only this DLCI backs off, the mux T1 is left to the other DLCIs */
+static void gsm_dlci_erm_backoff(struct gsm_dlci *dlci)
+{
+	if (IS_ENABLED(CONFIG_GSM_MUX_ADAPTIVE_TIMERS)) {
+		dlci->erm_t1 = MIN(dlci->erm_t1 * 2,
+				   MAX(gsm_dlci_erm_t1(dlci), TIMER_MAX_MSEC));
+	}
+}
+
+static void gsm_dlci_erm_timeout(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct gsm_dlci *dlci = CONTAINER_OF(dwork, struct gsm_dlci, erm_timer);
+	bool give_up = false;
+
+	k_mutex_lock(&dlci->erm_lock, K_FOREVER);
+
+	if (dlci->va != dlci->vs) {
+		if (dlci->erm_retries > 0) {
+			LOG_DBG("[%p] DLCI %d T1 timeout, resending from %d",
+				dlci->mux, dlci->num, dlci->va);
+
+			dlci->erm_retries--;
+			gsm_dlci_erm_backoff(dlci);
+			gsm_dlci_erm_retransmit(dlci);
+		} else {
+			give_up = true;
+		}
+	}
+
+	k_mutex_unlock(&dlci->erm_lock);
+
+	if (give_up) {
+		LOG_ERR("[%p] DLCI %d not acknowledged after %d retries",
+			dlci->mux, dlci->num, dlci->mux->retries);
+		(void)gsm_dlci_closing(dlci, NULL);
+	}
+}
+
+/* The whole buffer is queued or nothing is, a PPP frame must not be cut
+ * short. There is no waiting for buffers because the caller is usually
+ * the uart_mux work queue, which is also where the acknowledgements that
+ * release them are processed.
+ */
+static int gsm_dlci_erm_send(struct gsm_dlci *dlci, const uint8_t *buf,
+			     size_t size)
+{
+	struct net_buf *frame;
+	sys_slist_t frames;
+	size_t len;
+
+	sys_slist_init(&frames);
+
+	/* Split the data into I frames of at most N1 bytes */
+	while (size > 0) {
+		frame = net_buf_alloc(&gsm_erm_pool, K_NO_WAIT);
+		if (!frame) {
+			LOG_WRN("[%p] DLCI %d TX queue full, dropping %zu bytes",
+				dlci->mux, dlci->num, size);
+			dlci->mux->stats.alloc_failures++;
+			gsm_dlci_erm_free_list(&frames);
+			return -ENOBUFS;
+		}
+
+		len = MIN(size, MIN(net_buf_tailroom(frame), dlci->mux->mru));
+		net_buf_add_mem(frame, buf, len);
+		sys_slist_append(&frames, &frame->node);
+
+		buf += len;
+		size -= len;
+	}
+
+	k_mutex_lock(&dlci->erm_lock, K_FOREVER);
+
+	sys_slist_merge_slist(&dlci->erm_tx_queue, &frames);
+	(void)gsm_dlci_erm_kick(dlci);
+
+	k_mutex_unlock(&dlci->erm_lock);
+
+	return 0;
+}
+
+static int gsm_dlci_erm_recv(struct gsm_dlci *dlci, bool cmd)
+{
+	struct gsm_mux *mux = dlci->mux;
+	uint8_t control = mux->control;
+	bool pf = control & GSM_PF;
+	bool deliver = false;
+	bool ack = false;
+	int ret = 0;
+	int sent;
+
+	k_mutex_lock(&dlci->erm_lock, K_FOREVER);
+
+	gsm_dlci_erm_ack(dlci, ERM_NR(control));
+
+	if (!(control & 0x01)) {
+		if (ERM_NS(control) == dlci->vr) {
+			dlci->vr = (dlci->vr + 1) & ERM_MASK;
+			dlci->rej_sent = false;
+			deliver = true;
+			ack = true;
+		} else if (!dlci->rej_sent) {
+			/* Ask for everything starting from V(R) again */
+			dlci->rej_sent = true;
+			(void)gsm_dlci_erm_send_supervisory(dlci, false, FT_REJ,
+							    cmd && pf);
+		} else {
+			ack = cmd && pf;
+		}
+	} else {
+		switch (control & 0x0F) {
+		case FT_RR:
+			dlci->peer_busy = false;
+			break;
+		case FT_RNR:
+			dlci->peer_busy = true;
+			break;
+		case FT_REJ:
+			dlci->peer_busy = false;
+			gsm_dlci_erm_retransmit(dlci);
+			break;
+		}
+
+		/* A poll needs an answer even if there is nothing to ack */
+		ack = cmd && pf;
+	}
+
+	/* Acknowledge with our own I frames if there are any, a poll is
+	 * always answered with a supervisory frame with the F bit set.
+	 */
+	sent = gsm_dlci_erm_kick(dlci);
+	if (ack && (sent == 0 || (cmd && pf))) {
+		(void)gsm_dlci_erm_send_supervisory(dlci, false, FT_RR,
+						    cmd && pf);
+	}
+
+	k_mutex_unlock(&dlci->erm_lock);
+
+	if (deliver) {
+		ret = dlci->handler(dlci, cmd, mux->buf);
+	}
+
+	if (mux->buf) {
+		net_buf_unref(mux->buf);
+		mux->buf = NULL;
+	}
+
+	return ret;
+}
+#else
+static inline void gsm_dlci_erm_reset(struct gsm_dlci *dlci)
+{
+	ARG_UNUSED(dlci);
+}
+
+static inline int gsm_dlci_erm_send(struct gsm_dlci *dlci, const uint8_t *buf,
+				    size_t size)
+{
+	return -ENOTSUP;
+}
+
+static inline int gsm_dlci_erm_recv(struct gsm_dlci *dlci, bool cmd)
+{
+	return -ENOTSUP;
+}
+#endif /* CONFIG_GSM_MUX_ERROR_RECOVERY */
+
 static void dlci_run_timer(uint32_t current_time)
 {
 	struct gsm_dlci *dlci, *next;
@@ -473,10 +1022,20 @@ static void gsm_dlci_open(struct gsm_dlci *dlci)
 	LOG_DBG("[%p/%d] DLCI id %d open", dlci, dlci->num, dlci->num);
 	dlci->state = GSM_DLCI_OPEN;
 
+	if (gsm_dlci_is_erm(dlci)) {
+		gsm_dlci_erm_reset(dlci);
+	}
+
 	/* Remove this DLCI from pending T1 timers */
 	sys_slist_remove(&dlci_active_t1_timers, NULL, &dlci->node);
 	dlci_run_timer(k_uptime_get_32());
 
+	if (PROBE_INTERVAL_MSEC > 0 && dlci->num == 0 &&
+	    dlci->mode == GSM_DLCI_MODE_ABM) {
+		k_work_reschedule(&dlci->mux->probe_timer,
+				  K_MSEC(PROBE_INTERVAL_MSEC));
+	}
+
 	if (dlci->command_cb) {
 		dlci->command_cb(dlci, true);
 	}
@@ -487,6 +1046,10 @@ static void gsm_dlci_close(struct gsm_dlci *dlci)
 	LOG_DBG("[%p/%d] DLCI id %d closed", dlci, dlci->num, dlci->num);
 	dlci->state = GSM_DLCI_CLOSED;
 
+	if (gsm_dlci_is_erm(dlci)) {
+		gsm_dlci_erm_reset(dlci);
+	}
+
 	k_sem_give(&dlci->disconnect_sem);
 
 	/* Remove this DLCI from pending T1 timers */
@@ -499,6 +1062,7 @@ static void gsm_dlci_close(struct gsm_dlci *dlci)
 
 	if (dlci->num == 0) {
 		dlci->mux->refuse_service = true;
+		(void)k_work_cancel_delayable(&dlci->mux->probe_timer);
 	}
 }
 
@@ -510,6 +1074,9 @@ static bool handle_t1_timeout(struct gsm_dlci *dlci)
 	if (dlci->state == GSM_DLCI_OPENING) {
 		dlci->retries--;
 		if (dlci->retries) {
+			dlci->mux->stats.t1_retransmissions++;
+			dlci->stats.retransmissions++;
+			gsm_mux_timer_backoff(&dlci->mux->t1_timeout_value);
 			dlci->req_start = k_uptime_get_32();
 			(void)gsm_mux_send_command(dlci->mux, dlci->num, FT_SABM | GSM_PF);
 			return true;
@@ -529,6 +1096,10 @@ static bool handle_t1_timeout(struct gsm_dlci *dlci)
 	} else if (dlci->state == GSM_DLCI_CLOSING) {
 		dlci->retries--;
 		if (dlci->retries) {
+			dlci->mux->stats.t1_retransmissions++;
+			dlci->stats.retransmissions++;
+			gsm_mux_timer_backoff(&dlci->mux->t1_timeout_value);
+			dlci->req_start = k_uptime_get_32();
 			(void)gsm_mux_send_command(dlci->mux, dlci->num, FT_DISC | GSM_PF);
 			return true;
 		}
@@ -609,27 +1180,57 @@ static void gsm_mux_t2_timeout(struct k_work *work)
 {
 	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
 	struct gsm_mux *mux = CONTAINER_OF(dwork, struct gsm_mux, t2_timer);
+	struct gsm_dlci *dlci = gsm_dlci_get(mux, DLCI_CONTROL);
 	uint32_t current_time = k_uptime_get_32();
 	struct gsm_control_msg *entry, *next;
 
 	SYS_SLIST_FOR_EACH_CONTAINER_SAFE(&mux->pending_ctrls, entry, next,
 					  node) {
-		if ((int32_t)(entry->req_start + T2_MSEC - current_time) > 0) {
+		if ((int32_t)(entry->req_start + mux->t2_timeout_value -
+			      current_time) > 0) {
 			break;
 		}
 
-		ctrl_msg_cleanup(entry, true);
-
 		sys_slist_remove(&mux->pending_ctrls, NULL, &entry->node);
-		sys_slist_append(&ctrls_free_entries, &entry->node);
 
-		entry = NULL;
+		if (dlci && entry->retries > 0) {
+			LOG_DBG("[%p] T2 timeout, resending 0x%02x", mux,
+				entry->cmd);
+
+			entry->retries--;
+			entry->req_start = current_time;
+			mux->stats.t2_retransmissions++;
+			sys_slist_append(&mux->pending_ctrls, &entry->node);
+			gsm_mux_timer_backoff(&mux->t2_timeout_value);
+
+			(void)gsm_mux_send_data_msg(mux, mux->is_initiator, dlci,
+						    FT_UIH, entry->buf->data,
+						    entry->buf->len);
+			continue;
+		}
+
+#if defined(CONFIG_GSM_MUX_ERROR_RECOVERY)
+		/* No answer to PN, the DLCI is opened with UIH frames */
+		if (entry->cmd == (CMD_PN << 1)) {
+			uint8_t address = entry->buf->data[2] & 0x3F;
+
+			ctrl_msg_cleanup(entry, true);
+			sys_slist_append(&ctrls_free_entries, &entry->node);
+			gsm_dlci_pn_done(mux, address, NULL);
+			continue;
+		}
+#endif
+
+		ctrl_msg_cleanup(entry, true);
+		sys_slist_append(&ctrls_free_entries, &entry->node);
 	}
 
+	entry = SYS_SLIST_PEEK_HEAD_CONTAINER(&mux->pending_ctrls, entry, node);
 	if (entry) {
 		k_work_reschedule(
 			&mux->t2_timer,
-			K_MSEC(entry->req_start + T2_MSEC - current_time));
+			K_MSEC(entry->req_start + mux->t2_timeout_value -
+			       current_time));
 	}
 }
 
@@ -637,10 +1238,22 @@ static int gsm_mux_send_control_message(struct gsm_mux *mux, uint8_t dlci_addres
 					int cmd, uint8_t *data, size_t data_len)
 {
 	struct gsm_control_msg *ctrl;
+	struct gsm_dlci *dlci;
 	struct net_buf *buf;
 
+	dlci = gsm_dlci_get(mux, dlci_address);
+	if (!dlci) {
+		return -ENOENT;
+	}
+
+	/* Only one byte length field is supported for control messages */
+	if (data_len >= 128) {
+		return -EMSGSIZE;
+	}
+
 	/* We create a net_buf for the control message so that we can
-	 * resend it easily if needed.
+	 * resend it easily if needed. The buffer contains the type and
+	 * length fields followed by the values, see GSM 07.10 ch 5.4.6.1.
 	 */
 	buf = gsm_mux_alloc_buf(BUF_ALLOC_TIMEOUT, NULL);
 	if (!buf) {
@@ -648,6 +1261,9 @@ static int gsm_mux_send_control_message(struct gsm_mux *mux, uint8_t dlci_addres
 		return -ENOMEM;
 	}
 
+	net_buf_add_u8(buf, cmd | GSM_CR | GSM_EA);
+	net_buf_add_u8(buf, (data_len << 1) | GSM_EA);
+
 	if (data && data_len > 0) {
 		size_t added;
 
@@ -668,13 +1284,45 @@ static int gsm_mux_send_control_message(struct gsm_mux *mux, uint8_t dlci_addres
 
 	sys_slist_append(&mux->pending_ctrls, &ctrl->node);
 	ctrl->req_start = k_uptime_get_32();
+	ctrl->retries = mux->retries;
 
 	/* Let's start the timer if necessary */
 	if (!k_work_delayable_remaining_get(&mux->t2_timer)) {
-		k_work_reschedule(&mux->t2_timer, K_MSEC(T2_MSEC));
+		k_work_reschedule(&mux->t2_timer,
+				  K_MSEC(mux->t2_timeout_value));
 	}
 
-	return gsm_mux_modem_send(mux, buf->data, buf->len);
+	return gsm_mux_send_data_msg(mux, mux->is_initiator, dlci, FT_UIH,
+				     buf->data, buf->len);
+}
+
+/* Probe the round trip time with a test command when the link is idle */
+static void gsm_mux_probe_timeout(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct gsm_mux *mux = CONTAINER_OF(dwork, struct gsm_mux, probe_timer);
+	uint32_t current_time = k_uptime_get_32();
+	uint32_t idle = current_time - mux->last_rx;
+	struct gsm_control_msg *entry;
+
+	if (idle >= PROBE_INTERVAL_MSEC) {
+		SYS_SLIST_FOR_EACH_CONTAINER(&mux->pending_ctrls, entry, node) {
+			if (entry->cmd == CMD_TEST) {
+				break;
+			}
+		}
+
+		/* The test pattern is our uptime, it is echoed back as is */
+		if (!entry) {
+			(void)gsm_mux_send_control_message(
+				mux, DLCI_CONTROL, CMD_TEST,
+				(uint8_t *)&current_time, sizeof(current_time));
+		}
+
+		idle = 0;
+	}
+
+	k_work_reschedule(&mux->probe_timer, K_MSEC(PROBE_INTERVAL_MSEC - idle));
 }
 
 static int gsm_dlci_opening_or_closing(struct gsm_dlci *dlci,
@@ -736,6 +1384,7 @@ int gsm_mux_disconnect(struct gsm_mux *mux, k_timeout_t timeout)
 					   CMD_CLD, NULL, 0);
 
 	(void)k_work_cancel_delayable(&mux->t2_timer);
+	(void)k_work_cancel_delayable(&mux->probe_timer);
 
 	(void)gsm_dlci_closing(dlci, NULL);
 
@@ -805,6 +1454,76 @@ static int gsm_mux_msc_reply(struct gsm_dlci *dlci, bool cmd,
 	return gsm_mux_control_reply(dlci, cmd, CMD_MSC, buf->data, len);
 }
 
+#if defined(CONFIG_GSM_MUX_ERROR_RECOVERY)
+/* Ask the peer to use I frames on a data DLCI. The DLCI is opened when
+ * the peer has answered, see gsm_dlci_pn_done().
+ */
+static int gsm_dlci_pn_send(struct gsm_dlci *dlci)
+{
+	struct gsm_mux *mux = dlci->mux;
+	uint8_t pn[PN_LEN];
+
+	pn[0] = dlci->num;
+	pn[1] = PN_FRAME_I;
+	pn[2] = dlci->num | 0x07; /* default priority, GSM 07.10 ch 5.6 */
+	pn[3] = MIN(mux->t1_timeout_value / TIMER_GRANULARITY_MSEC, UINT8_MAX);
+	sys_put_le16(mux->mru, &pn[4]);
+	pn[6] = mux->retries;
+	pn[7] = ERM_WINDOW;
+
+	/* The type field is EA encoded on the wire, see get_field() */
+	return gsm_mux_send_control_message(mux, DLCI_CONTROL, CMD_PN << 1,
+					    pn, sizeof(pn));
+}
+
+/* Answer a PN command, I frames are accepted if the peer asks for them */
+static int gsm_mux_pn_reply(struct gsm_dlci *dlci, struct net_buf *buf,
+			    size_t len)
+{
+	struct gsm_mux *mux = dlci->mux;
+	uint8_t reply[2 + PN_LEN];
+	uint8_t address, window = 0;
+
+	if (len < PN_LEN || buf->len < PN_LEN) {
+		LOG_DBG("[%p] Malformed data", mux);
+		return -EINVAL;
+	}
+
+	address = buf->data[0] & 0x3F;
+
+	if (address != DLCI_CONTROL &&
+	    (buf->data[1] & 0x0F) == PN_FRAME_I) {
+		window = CLAMP(buf->data[7] & ERM_MASK, 1, ERM_WINDOW);
+	}
+
+	mux->erm_window[address] = window;
+
+	LOG_DBG("[%p] DLCI %d uses %s frames", mux, address,
+		window ? "I" : "UIH");
+
+	/* The parameters are echoed back with the values we accept */
+	reply[0] = (CMD_PN << 1) | GSM_EA;
+	reply[1] = (PN_LEN << 1) | GSM_EA;
+	memcpy(&reply[2], buf->data, PN_LEN);
+	reply[3] = window ? PN_FRAME_I : PN_FRAME_UIH;
+	reply[9] = window;
+
+	return gsm_mux_control_reply(dlci, false, CMD_PN, reply,
+				     sizeof(reply));
+}
+#else
+static inline int gsm_dlci_pn_send(struct gsm_dlci *dlci)
+{
+	return -ENOTSUP;
+}
+
+static inline int gsm_mux_pn_reply(struct gsm_dlci *dlci,
+				   struct net_buf *buf, size_t len)
+{
+	return -ENOTSUP;
+}
+#endif /* CONFIG_GSM_MUX_ERROR_RECOVERY */
+
 static int gsm_mux_control_message(struct gsm_dlci *dlci, struct net_buf *buf)
 {
 	uint32_t command = 0, len = 0;
@@ -844,11 +1563,23 @@ static int gsm_mux_control_message(struct gsm_dlci *dlci, struct net_buf *buf)
 
 	case CMD_FCOFF:
 		/* Do not accept data */
+		if (!dlci->mux->fcoff) {
+			dlci->mux->fcoff = true;
+			dlci->mux->fcoff_start = k_uptime_get_32();
+			dlci->mux->stats.fcoff_count++;
+		}
+
 		ret = gsm_mux_control_reply(dlci, cr, CMD_FCOFF, NULL, 0);
 		break;
 
 	case CMD_FCON:
 		/* Accepting data */
+		if (dlci->mux->fcoff) {
+			dlci->mux->fcoff = false;
+			dlci->mux->stats.fcoff_ms +=
+				k_uptime_get_32() - dlci->mux->fcoff_start;
+		}
+
 		ret = gsm_mux_control_reply(dlci, cr, CMD_FCON, NULL, 0);
 		break;
 
@@ -876,12 +1607,21 @@ static int gsm_mux_control_message(struct gsm_dlci *dlci, struct net_buf *buf)
 					    buf->data, len);
 		break;
 
-	/* Optional and currently unsupported commands */
 	case CMD_PN:	/* Parameter negotiation */
+		/* Only the frame type matters, for error recovery mode */
+		if (IS_ENABLED(CONFIG_GSM_MUX_ERROR_RECOVERY)) {
+			ret = gsm_mux_pn_reply(dlci, buf, len);
+			break;
+		}
+
+		__fallthrough;
+
+	/* Optional and currently unsupported commands */
 	case CMD_RPN:	/* Remote port negotiation */
 	case CMD_SNC:	/* Service negotiation command */
 	default:
 		/* Reply to bad commands with an NSC */
+		dlci->mux->stats.nsc_replies++;
 		buf->data[0] = command | (cr ? GSM_CR : 0);
 		buf->len = 1;
 		ret = gsm_mux_control_reply(dlci, cr, CMD_NSC, buf->data, len);
@@ -894,23 +1634,65 @@ static int gsm_mux_control_message(struct gsm_dlci *dlci, struct net_buf *buf)
 /* Handle a response to our control message */
 static int gsm_mux_control_response(struct gsm_dlci *dlci, struct net_buf *buf)
 {
+	struct gsm_mux *mux = dlci->mux;
 	struct gsm_control_msg *entry, *next;
+	sys_snode_t *prev_node = NULL;
+	bool nsc = false;
+	int pn_dlci = -1;
+	uint8_t type;
+
+	if (!buf || buf->len == 0) {
+		LOG_DBG("[%p] Malformed data", mux);
+		return -EINVAL;
+	}
+
+	type = buf->data[0] & ~(GSM_CR | GSM_EA);
+
+	/* NSC carries the type of the command the peer does not support */
+	if (type == CMD_NSC && buf->len > 2) {
+		type = buf->data[2] & ~(GSM_CR | GSM_EA);
+		nsc = true;
+	}
 
-	SYS_SLIST_FOR_EACH_CONTAINER_SAFE(&dlci->mux->pending_ctrls,
+	SYS_SLIST_FOR_EACH_CONTAINER_SAFE(&mux->pending_ctrls,
 					  entry, next, node) {
-		if (dlci->mux->control == entry->cmd) {
-			sys_slist_remove(&dlci->mux->pending_ctrls, NULL,
-					 &entry->node);
-			sys_slist_append(&ctrls_free_entries, &entry->node);
-			entry->finished = true;
+		if (entry->cmd != type) {
+			prev_node = &entry->node;
+			continue;
+		}
 
-			if (dlci->command_cb) {
-				dlci->command_cb(dlci, true);
+		/* PN responses are told apart by the DLCI they are for */
+		if (type == (CMD_PN << 1)) {
+			if (!nsc && (buf->len < 2 + PN_LEN ||
+				     buf->data[2] != entry->buf->data[2])) {
+				prev_node = &entry->node;
+				continue;
 			}
 
-			break;
+			pn_dlci = entry->buf->data[2] & 0x3F;
+		}
+
+		/* Karn's algorithm, a retransmitted command gives an
+		 * ambiguous sample so skip it.
+		 */
+		if (entry->retries == mux->retries) {
+			gsm_mux_t2_sample(mux,
+					  k_uptime_get_32() - entry->req_start);
 		}
+
+		sys_slist_remove(&mux->pending_ctrls, prev_node,
+				 &entry->node);
+		ctrl_msg_cleanup(entry, true);
+		sys_slist_append(&ctrls_free_entries, &entry->node);
+		entry->finished = true;
+		break;
+	}
+
+#if defined(CONFIG_GSM_MUX_ERROR_RECOVERY)
+	if (pn_dlci >= 0) {
+		gsm_dlci_pn_done(mux, pn_dlci, nsc ? NULL : buf);
 	}
+#endif
 
 	return 0;
 }
@@ -920,6 +1702,14 @@ static int gsm_dlci_process_command(struct gsm_dlci *dlci, bool cmd,
 {
 	int ret;
 
+	/* The C/R bit of the type field tells commands and responses apart,
+	 * GSM 07.10 ch 5.4.6.2. Modems do not agree on the C/R bit of the
+	 * frame itself, so it cannot be trusted here.
+	 */
+	if (buf && buf->len > 0) {
+		cmd = buf->data[0] & GSM_CR;
+	}
+
 	LOG_DBG("[%p] DLCI %d control %s", dlci->mux, dlci->num,
 		cmd ? "request" : "response");
 	hexdump_buf("buf", buf);
@@ -991,6 +1781,7 @@ static struct gsm_dlci *gsm_dlci_alloc(struct gsm_mux *mux, uint8_t address,
 	dlci->uart = uart;
 	dlci->user_data = user_data;
 	dlci->dlci_created_cb = dlci_created_cb;
+	memset(&dlci->stats, 0, sizeof(dlci->stats));
 
 	/* Command channel (0) handling is separated from data */
 	if (dlci->num) {
@@ -999,6 +1790,12 @@ static struct gsm_dlci *gsm_dlci_alloc(struct gsm_mux *mux, uint8_t address,
 		dlci->handler = gsm_dlci_process_command;
 	}
 
+#if defined(CONFIG_GSM_MUX_ERROR_RECOVERY)
+	/* I frames are only used if PN said so, never on the control channel */
+	dlci->erm_window = mux->erm_window[address & 0x3F];
+	gsm_dlci_erm_reset(dlci);
+#endif
+
 	return dlci;
 }
 
@@ -1024,6 +1821,27 @@ static int gsm_mux_process_pkt(struct gsm_mux *mux)
 
 	dlci = gsm_dlci_get(mux, dlci_address);
 
+	mux->stats.rx_frames++;
+	mux->stats.rx_bytes += mux->buf ? net_buf_frags_len(mux->buf) : 0;
+
+	if (dlci) {
+		dlci->stats.rx_frames++;
+		dlci->stats.rx_bytes += mux->buf ?
+			net_buf_frags_len(mux->buf) : 0;
+	}
+
+	if (dlci && gsm_dlci_is_erm(dlci) &&
+	    gsm_mux_is_erm_frame(mux->control)) {
+		if (dlci->state != GSM_DLCI_OPEN) {
+			(void)gsm_mux_send_command(mux, dlci_address, FT_DM | GSM_PF);
+			ret = -ENOENT;
+			goto out;
+		}
+
+		ret = gsm_dlci_erm_recv(dlci, cmd);
+		goto out;
+	}
+
 	/* What to do next */
 	switch (mux->control) {
 	case FT_SABM | GSM_PF:
@@ -1033,12 +1851,14 @@ static int gsm_mux_process_pkt(struct gsm_mux *mux)
 		}
 
 		if (dlci == NULL) {
-			const struct device *uart;
-
-			uart = uart_mux_find(dlci_address);
-			if (uart == NULL) {
-				ret = -ENOENT;
-				goto fail;
+			const struct device *uart = NULL;
+
+			if (mux->transport == NULL) {
+				uart = uart_mux_find(dlci_address);
+				if (uart == NULL) {
+					ret = -ENOENT;
+					goto fail;
+				}
 			}
 
 			dlci = gsm_dlci_alloc(mux, dlci_address, uart, NULL,
@@ -1050,6 +1870,7 @@ static int gsm_mux_process_pkt(struct gsm_mux *mux)
 		}
 
 		if (dlci->refuse_service) {
+			dlci->stats.refused++;
 			ret = gsm_mux_send_response(mux, dlci_address, FT_DM);
 		} else {
 			ret = gsm_mux_send_response(mux, dlci_address, FT_UA);
@@ -1081,6 +1902,14 @@ static int gsm_mux_process_pkt(struct gsm_mux *mux)
 			goto out;
 		}
 
+		/* Karn's algorithm, only sample commands sent once */
+		if ((dlci->state == GSM_DLCI_OPENING ||
+		     dlci->state == GSM_DLCI_CLOSING) &&
+		    dlci->retries == mux->retries) {
+			gsm_mux_t1_sample(mux,
+					  k_uptime_get_32() - dlci->req_start);
+		}
+
 		switch (dlci->state) {
 		case GSM_DLCI_CLOSING:
 			gsm_dlci_close(dlci);
@@ -1101,6 +1930,8 @@ static int gsm_mux_process_pkt(struct gsm_mux *mux)
 			goto fail;
 		}
 
+		mux->stats.dlci_refused++;
+		dlci->stats.refused++;
 		gsm_dlci_close(dlci);
 		break;
 
@@ -1141,6 +1972,11 @@ static bool is_UI(struct gsm_mux *mux)
 	return (mux->control & ~GSM_PF) == FT_UI;
 }
 
+static bool is_I(struct gsm_mux *mux)
+{
+	return !(mux->control & 0x01);
+}
+
 static const char *gsm_mux_state_str(enum gsm_mux_state state)
 {
 #if (CONFIG_GSM_MUX_LOG_LEVEL >= LOG_LEVEL_DBG) || defined(CONFIG_NET_SHELL)
@@ -1161,6 +1997,8 @@ static const char *gsm_mux_state_str(enum gsm_mux_state state)
 		return "FCS";
 	case GSM_MUX_EOF:
 		return "End-Of-Frame";
+	case GSM_MUX_RESYNC:
+		return "Resync";
 	}
 #else
 	ARG_UNUSED(state);
@@ -1173,21 +2011,23 @@ static const char *gsm_mux_state_str(enum gsm_mux_state state)
 static void validate_state_transition(enum gsm_mux_state current,
 				      enum gsm_mux_state new)
 {
-	static const uint8_t valid_transitions[] = {
+	static const uint16_t valid_transitions[] = {
 		[GSM_MUX_SOF] = 1 << GSM_MUX_ADDRESS,
 		[GSM_MUX_ADDRESS] = 1 << GSM_MUX_CONTROL,
 		[GSM_MUX_CONTROL] = 1 << GSM_MUX_LEN_0,
 		[GSM_MUX_LEN_0] = 1 << GSM_MUX_LEN_1 |
 				1 << GSM_MUX_DATA |
 				1 << GSM_MUX_FCS |
-				1 << GSM_MUX_SOF,
+				1 << GSM_MUX_RESYNC,
 		[GSM_MUX_LEN_1] = 1 << GSM_MUX_DATA |
 				1 << GSM_MUX_FCS |
-				1 << GSM_MUX_SOF,
+				1 << GSM_MUX_RESYNC,
 		[GSM_MUX_DATA] = 1 << GSM_MUX_FCS |
 				1 << GSM_MUX_SOF,
-		[GSM_MUX_FCS] = 1 << GSM_MUX_EOF,
-		[GSM_MUX_EOF] = 1 << GSM_MUX_SOF
+		[GSM_MUX_FCS] = 1 << GSM_MUX_EOF |
+				1 << GSM_MUX_RESYNC,
+		[GSM_MUX_EOF] = 1 << GSM_MUX_SOF,
+		[GSM_MUX_RESYNC] = 1 << GSM_MUX_SOF
 	};
 
 	if (!(valid_transitions[current] & 1 << new)) {
@@ -1227,9 +2067,114 @@ void gsm_mux_change_state(struct gsm_mux *mux, enum gsm_mux_state new_state)
 	mux->state = new_state;
 }
 
+static void gsm_mux_enter_resync(struct gsm_mux *mux)
+{
+	mux->stats.resync_events++;
+
+	if (mux->buf) {
+		net_buf_unref(mux->buf);
+		mux->buf = NULL;
+	}
+
+	gsm_mux_change_state(mux, GSM_MUX_RESYNC);
+}
+
+/* Check if the data starting with a flag looks like a valid frame header.
+ * If the frame is complete in the buffer, the FCS is verified too. When
+ * there is not enough data to tell, the frame is given the benefit of the
+ * doubt and the parser will resync again if it was wrong.
+ */
+static bool gsm_mux_frame_plausible(struct gsm_mux *mux, const uint8_t *frame,
+				    size_t len)
+{
+	uint8_t address, control, fcs;
+	size_t msg_len, hdr_len;
+
+	if (len < 4) {
+		return true;
+	}
+
+	address = frame[1];
+	control = frame[2];
+
+	/* Only one byte addresses are supported */
+	if (!(address & GSM_EA) || address == SOF_MARKER) {
+		return false;
+	}
+
+	if (!get_frame_type_str(control & ~GSM_PF) &&
+	    !(IS_ENABLED(CONFIG_GSM_MUX_ERROR_RECOVERY) &&
+	      gsm_mux_is_erm_frame(control))) {
+		return false;
+	}
+
+	if (frame[3] & GSM_EA) {
+		msg_len = frame[3] >> 1;
+		hdr_len = 3;
+	} else {
+		if (len < 5) {
+			return true;
+		}
+
+		msg_len = (frame[3] >> 1) | (frame[4] << 7);
+		hdr_len = 4;
+	}
+
+	if (msg_len > mux->mru) {
+		return false;
+	}
+
+	if (len < 1 + hdr_len + msg_len + 1) {
+		return true;
+	}
+
+	fcs = gsm_mux_fcs_add_buf(FCS_INIT_VALUE, &frame[1], hdr_len);
+	if ((control & ~GSM_PF) != FT_UIH) {
+		fcs = gsm_mux_fcs_add_buf(fcs, &frame[1 + hdr_len], msg_len);
+	}
+
+	fcs = gsm_mux_fcs_add(fcs, frame[1 + hdr_len + msg_len]);
+
+	return fcs == FCS_GOOD_VALUE;
+}
+
+/* Skip data until a plausible frame start is found. Returns the number of
+ * bytes discarded, the parser continues from the flag if one was found.
+ */
+static int gsm_mux_resync(struct gsm_mux *mux, const uint8_t *buf, int len)
+{
+	const uint8_t *end = buf + len;
+	const uint8_t *pos = buf;
+	int skipped;
+
+	while ((pos = memchr(pos, SOF_MARKER, end - pos)) != NULL) {
+		/* Flags can be repeated, the last one opens the frame */
+		while (pos + 1 < end && pos[1] == SOF_MARKER) {
+			pos++;
+		}
+
+		if (gsm_mux_frame_plausible(mux, pos, end - pos)) {
+			gsm_mux_change_state(mux, GSM_MUX_SOF);
+			break;
+		}
+
+		pos++;
+	}
+
+	skipped = pos ? pos - buf : len;
+	mux->stats.resync_discarded += skipped;
+
+	if (pos) {
+		LOG_DBG("[%p] resync, skipped %d bytes", mux, skipped);
+	}
+
+	return skipped;
+}
+
 static void gsm_mux_process_data(struct gsm_mux *mux, uint8_t recv_byte)
 {
 	size_t bytes_added;
+	int ret;
 
 	switch (mux->state) {
 	case GSM_MUX_SOF:
@@ -1251,6 +2196,11 @@ static void gsm_mux_process_data(struct gsm_mux *mux, uint8_t recv_byte)
 		break;
 
 	case GSM_MUX_ADDRESS:
+		/* Repeated flag, the frame starts after it */
+		if (recv_byte == SOF_MARKER) {
+			break;
+		}
+
 		/* DLCI (Data Link Connection Identifier) address we want to
 		 * talk. This address field also contains C/R bit.
 		 * Currently we only support one byte addresses.
@@ -1277,7 +2227,8 @@ static void gsm_mux_process_data(struct gsm_mux *mux, uint8_t recv_byte)
 
 		if (gsm_mux_read_msg_len(mux, recv_byte)) {
 			if (mux->msg_len > mux->mru) {
-				gsm_mux_change_state(mux, GSM_MUX_SOF);
+				mux->stats.oversize_drops++;
+				gsm_mux_enter_resync(mux);
 			} else if (mux->msg_len == 0) {
 				gsm_mux_change_state(mux, GSM_MUX_FCS);
 			} else {
@@ -1296,7 +2247,8 @@ static void gsm_mux_process_data(struct gsm_mux *mux, uint8_t recv_byte)
 
 		mux->msg_len |= recv_byte << 7;
 		if (mux->msg_len > mux->mru) {
-			gsm_mux_change_state(mux, GSM_MUX_SOF);
+			mux->stats.oversize_drops++;
+			gsm_mux_enter_resync(mux);
 		} else if (mux->msg_len == 0) {
 			gsm_mux_change_state(mux, GSM_MUX_FCS);
 		} else {
@@ -1314,6 +2266,7 @@ static void gsm_mux_process_data(struct gsm_mux *mux, uint8_t recv_byte)
 			if (mux->buf == NULL) {
 				LOG_ERR("[%p] Can't allocate RX data! "
 					"Skipping data!", mux);
+				mux->stats.alloc_failures++;
 				gsm_mux_change_state(mux, GSM_MUX_SOF);
 				break;
 			}
@@ -1325,6 +2278,7 @@ static void gsm_mux_process_data(struct gsm_mux *mux, uint8_t recv_byte)
 						   gsm_mux_alloc_buf,
 						   &gsm_mux_pool);
 		if (bytes_added != 1) {
+			mux->stats.alloc_failures++;
 			gsm_mux_change_state(mux, GSM_MUX_SOF);
 		} else if (++mux->received == mux->msg_len) {
 			gsm_mux_change_state(mux, GSM_MUX_FCS);
@@ -1335,8 +2289,10 @@ static void gsm_mux_process_data(struct gsm_mux *mux, uint8_t recv_byte)
 	case GSM_MUX_FCS:
 		mux->received_fcs = recv_byte;
 
-		/* Update the FCS for Unnumbered Information field (UI) */
-		if (is_UI(mux)) {
+		/* Update the FCS for Unnumbered Information field (UI)
+		 * and Information field (I)
+		 */
+		if (is_UI(mux) || is_I(mux)) {
 			struct net_buf *buf = mux->buf;
 
 			while (buf) {
@@ -1348,13 +2304,16 @@ static void gsm_mux_process_data(struct gsm_mux *mux, uint8_t recv_byte)
 		}
 
 		mux->fcs = gsm_mux_fcs_add(mux->fcs, mux->received_fcs);
-		if (mux->fcs == FCS_GOOD_VALUE) {
-			int ret = gsm_mux_process_pkt(mux);
+		if (mux->fcs != FCS_GOOD_VALUE) {
+			LOG_DBG("[%p] FCS error", mux);
+			mux->stats.fcs_errors++;
+			gsm_mux_enter_resync(mux);
+			break;
+		}
 
-			if (ret < 0) {
-				LOG_DBG("[%p] Cannot process pkt (%d)", mux,
-					ret);
-			}
+		ret = gsm_mux_process_pkt(mux);
+		if (ret < 0) {
+			LOG_DBG("[%p] Cannot process pkt (%d)", mux, ret);
 		}
 
 		gsm_mux_change_state(mux, GSM_MUX_EOF);
@@ -1366,6 +2325,10 @@ static void gsm_mux_process_data(struct gsm_mux *mux, uint8_t recv_byte)
 		}
 
 		break;
+
+	case GSM_MUX_RESYNC:
+		/* Handled a buffer at a time by gsm_mux_resync() */
+		break;
 	}
 }
 
@@ -1375,7 +2338,14 @@ void gsm_mux_recv_buf(struct gsm_mux *mux, uint8_t *buf, int len)
 
 	LOG_DBG("Received %d bytes", len);
 
+	mux->last_rx = k_uptime_get_32();
+
 	while (i < len) {
+		if (mux->state == GSM_MUX_RESYNC) {
+			i += gsm_mux_resync(mux, &buf[i], len - i);
+			continue;
+		}
+
 		gsm_mux_process_data(mux, buf[i++]);
 	}
 }
@@ -1391,6 +2361,39 @@ static void dlci_done(struct gsm_dlci *dlci, bool connected)
 	}
 }
 
+#if defined(CONFIG_GSM_MUX_ERROR_RECOVERY)
+static void gsm_dlci_pn_done(struct gsm_mux *mux, uint8_t address,
+			     struct net_buf *rsp)
+{
+	struct gsm_dlci *dlci = gsm_dlci_get(mux, address);
+	uint8_t window = 0;
+	int ret;
+
+	if (!dlci || dlci->state != GSM_DLCI_CLOSED) {
+		return;
+	}
+
+	/* The response holds the type byte and length before the values */
+	if (rsp && (rsp->data[3] & 0x0F) == PN_FRAME_I) {
+		window = CLAMP(rsp->data[9] & ERM_MASK, 1, ERM_WINDOW);
+	}
+
+	if (!window) {
+		LOG_WRN("[%p] DLCI %d peer refused I frames, error recovery "
+			"mode is not used", mux, address);
+	}
+
+	mux->erm_window[address] = window;
+	dlci->erm_window = window;
+
+	ret = gsm_dlci_opening(dlci, dlci_done);
+	if (ret < 0 && ret != -EALREADY) {
+		LOG_ERR("[%p] Cannot open DLCI %d", mux, address);
+		dlci_done(dlci, false);
+	}
+}
+#endif
+
 int gsm_dlci_create(struct gsm_mux *mux,
 		    const struct device *uart,
 		    int dlci_address,
@@ -1408,7 +2411,16 @@ int gsm_dlci_create(struct gsm_mux *mux,
 		goto fail;
 	}
 
-	ret = gsm_dlci_opening(*dlci, dlci_done);
+	/* Negotiate I frames first for error recovery mode, the DLCI is
+	 * opened once the peer has answered.
+	 */
+	if (IS_ENABLED(CONFIG_GSM_MUX_ERROR_RECOVERY) &&
+	    dlci_address != DLCI_CONTROL) {
+		ret = gsm_dlci_pn_send(*dlci);
+	} else {
+		ret = gsm_dlci_opening(*dlci, dlci_done);
+	}
+
 	if (ret < 0 && ret != -EALREADY) {
 		LOG_ERR("[%p] Cannot open DLCI %d", mux, dlci_address);
 		gsm_dlci_free(mux, dlci_address);
@@ -1423,6 +2435,10 @@ fail:
 
 int gsm_dlci_send(struct gsm_dlci *dlci, const uint8_t *buf, size_t size)
 {
+	if (gsm_dlci_is_erm(dlci)) {
+		return gsm_dlci_erm_send(dlci, buf, size);
+	}
+
 	/* Mux the data and send to UART */
 	return gsm_mux_send_data_msg(dlci->mux, true, dlci, FT_UIH, buf, size);
 }
@@ -1432,6 +2448,74 @@ int gsm_dlci_id(struct gsm_dlci *dlci)
 	return dlci->num;
 }
 
+int gsm_mux_timers_get(struct gsm_mux *mux, struct gsm_mux_timers *timers)
+{
+	if (mux == NULL || timers == NULL) {
+		return -EINVAL;
+	}
+
+	timers->t1 = mux->t1_timeout_value;
+	timers->t2 = mux->t2_timeout_value;
+	timers->t1_srtt = mux->t1_rtt.srtt >> 3;
+	timers->t1_rttvar = mux->t1_rtt.rttvar >> 2;
+	timers->t2_srtt = mux->t2_rtt.srtt >> 3;
+	timers->t2_rttvar = mux->t2_rtt.rttvar >> 2;
+	timers->samples = mux->rtt_samples;
+	memcpy(timers->rtt_hist, mux->rtt_hist, sizeof(timers->rtt_hist));
+
+	return 0;
+}
+
+int gsm_mux_stats_get(struct gsm_mux *mux, struct gsm_mux_stats *stats)
+{
+	if (mux == NULL || stats == NULL) {
+		return -EINVAL;
+	}
+
+	*stats = mux->stats;
+
+	/* Include the ongoing flow control off period */
+	if (mux->fcoff) {
+		stats->fcoff_ms += k_uptime_get_32() - mux->fcoff_start;
+	}
+
+	return 0;
+}
+
+int gsm_dlci_stats_get(struct gsm_dlci *dlci, struct gsm_dlci_stats *stats)
+{
+	if (dlci == NULL || stats == NULL) {
+		return -EINVAL;
+	}
+
+	*stats = dlci->stats;
+
+	return 0;
+}
+
+void gsm_mux_foreach(gsm_mux_foreach_cb_t cb, void *user_data)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(muxes); i++) {
+		if (muxes[i].in_use) {
+			cb(&muxes[i], user_data);
+		}
+	}
+}
+
+void gsm_mux_dlci_foreach(struct gsm_mux *mux, gsm_dlci_foreach_cb_t cb,
+			  void *user_data)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(dlcis); i++) {
+		if (dlcis[i].in_use && dlcis[i].mux == mux) {
+			cb(&dlcis[i], user_data);
+		}
+	}
+}
+
 struct gsm_mux *gsm_mux_create(const struct device *uart)
 {
 	struct gsm_mux *mux = NULL;
@@ -1468,6 +2552,7 @@ struct gsm_mux *gsm_mux_create(const struct device *uart)
 		mux->buf = NULL;
 
 		k_work_init_delayable(&mux->t2_timer, gsm_mux_t2_timeout);
+		k_work_init_delayable(&mux->probe_timer, gsm_mux_probe_timeout);
 		sys_slist_init(&mux->pending_ctrls);
 
 		/* The system will continue after the control DLCI is
@@ -1479,6 +2564,65 @@ struct gsm_mux *gsm_mux_create(const struct device *uart)
 	return mux;
 }
 
+struct gsm_mux *gsm_mux_create_transport(
+	const struct gsm_mux_transport *transport)
+{
+	struct gsm_mux *mux;
+
+	if (transport == NULL || transport->send == NULL ||
+	    transport->recv == NULL) {
+		return NULL;
+	}
+
+	mux = gsm_mux_create(NULL);
+	if (mux) {
+		mux->transport = transport;
+		mux->is_initiator = transport->is_initiator;
+	}
+
+	return mux;
+}
+
+void gsm_mux_release(struct gsm_mux *mux)
+{
+	struct gsm_control_msg *entry;
+	sys_snode_t *node;
+	int i;
+
+	(void)k_work_cancel_delayable(&mux->t2_timer);
+	(void)k_work_cancel_delayable(&mux->probe_timer);
+
+	for (i = 0; i < ARRAY_SIZE(dlcis); i++) {
+		if (dlcis[i].mux != mux || !dlcis[i].in_use) {
+			continue;
+		}
+
+		if (gsm_dlci_is_erm(&dlcis[i])) {
+			gsm_dlci_erm_reset(&dlcis[i]);
+		}
+
+		if (sys_slist_find_and_remove(&dlci_active_t1_timers,
+					      &dlcis[i].node)) {
+			dlci_run_timer(k_uptime_get_32());
+		}
+	}
+
+	gsm_mux_detach(mux);
+
+	while ((node = sys_slist_get(&mux->pending_ctrls)) != NULL) {
+		entry = CONTAINER_OF(node, struct gsm_control_msg, node);
+		ctrl_msg_cleanup(entry, true);
+		sys_slist_append(&ctrls_free_entries, &entry->node);
+	}
+
+	if (mux->buf) {
+		net_buf_unref(mux->buf);
+		mux->buf = NULL;
+	}
+
+	mux->in_use = false;
+}
+
 int gsm_mux_send(struct gsm_mux *mux, uint8_t dlci_address,
 		 const uint8_t *buf, size_t size)
 {
@@ -1489,8 +2633,7 @@ int gsm_mux_send(struct gsm_mux *mux, uint8_t dlci_address,
 		return -ENOENT;
 	}
 
-	/* Mux the data and send to UART */
-	return gsm_mux_send_data_msg(mux, true, dlci, FT_UIH, buf, size);
+	return gsm_dlci_send(dlci, buf, size);
 }
 
 void gsm_mux_detach(struct gsm_mux *mux)
@@ -1529,6 +2672,13 @@ void gsm_mux_init(void)
 
 	for (i = 0; i < ARRAY_SIZE(dlcis); i++) {
 		sys_slist_prepend(&dlci_free_entries, &dlcis[i].node);
+
+#if defined(CONFIG_GSM_MUX_ERROR_RECOVERY)
+		k_mutex_init(&dlcis[i].erm_lock);
+		k_work_init_delayable(&dlcis[i].erm_timer,
+				      gsm_dlci_erm_timeout);
+		sys_slist_init(&dlcis[i].erm_tx_queue);
+#endif
 	}
 
 	k_work_init_delayable(&t1_timer, dlci_t1_timeout);
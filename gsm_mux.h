@@ -17,10 +17,73 @@
 struct gsm_mux;
 struct gsm_dlci;
 
+/* RTT histogram bucket n counts samples in [2^(n-1), 2^n) ms */
+#define GSM_MUX_RTT_HIST_LEN 12
+
+struct gsm_mux_timers {
+	uint16_t t1;        /* current T1 value in ms */
+	uint16_t t2;        /* current T2 value in ms */
+	uint32_t t1_srtt;   /* smoothed SABM/DISC -> UA round trip in ms */
+	uint32_t t1_rttvar; /* SABM/DISC -> UA round trip variation in ms */
+	uint32_t t2_srtt;   /* smoothed control command round trip in ms */
+	uint32_t t2_rttvar; /* control command round trip variation in ms */
+	uint32_t samples;
+	uint32_t rtt_hist[GSM_MUX_RTT_HIST_LEN];
+};
+
+/* Transport to use instead of a UART, for example to connect two muxes
+ * back to back for benchmarking.
+ */
+struct gsm_mux_transport {
+	/* Send raw mux data to the peer */
+	int (*send)(struct gsm_mux *mux, const uint8_t *buf, size_t size,
+		    void *user_data);
+	/* Data received on a DLCI */
+	void (*recv)(struct gsm_mux *mux, int dlci_address,
+		     const uint8_t *buf, size_t size, void *user_data);
+	void *user_data;
+	/* Line rate in bit/s for the acknowledgement timer, 0 if unknown */
+	uint32_t baudrate;
+	bool is_initiator;
+};
+
+struct gsm_mux_stats {
+	uint32_t rx_frames;          /* frames with a valid FCS */
+	uint32_t rx_bytes;           /* payload bytes received */
+	uint32_t tx_frames;
+	uint32_t tx_bytes;           /* payload bytes sent */
+	uint32_t fcs_errors;
+	uint32_t oversize_drops;     /* frames longer than the MRU */
+	uint32_t alloc_failures;     /* frames dropped for lack of buffers */
+	uint32_t resync_events;
+	uint32_t resync_discarded;   /* bytes skipped while resyncing */
+	uint32_t t1_retransmissions; /* SABM/DISC resent */
+	uint32_t t2_retransmissions; /* control commands resent */
+	uint32_t nsc_replies;        /* unsupported commands received */
+	uint32_t dlci_refused;       /* DM sent or received for a DLCI */
+	uint32_t fcoff_count;
+	uint32_t fcoff_ms;           /* time spent in flow control off */
+};
+
+struct gsm_dlci_stats {
+	uint32_t rx_frames;
+	uint32_t rx_bytes;
+	uint32_t tx_frames;
+	uint32_t tx_bytes;
+	uint32_t retransmissions; /* SABM/DISC and I frames resent */
+	uint32_t refused;         /* DM sent or received */
+};
+
+typedef void (*gsm_mux_foreach_cb_t)(struct gsm_mux *mux, void *user_data);
+typedef void (*gsm_dlci_foreach_cb_t)(struct gsm_dlci *dlci, void *user_data);
+
 void gsm_mux_recv_buf(struct gsm_mux *mux, uint8_t *buf, int len);
 int gsm_mux_send(struct gsm_mux *mux, uint8_t dlci_address,
 		 const uint8_t *buf, size_t size);
 struct gsm_mux *gsm_mux_create(const struct device *uart);
+struct gsm_mux *gsm_mux_create_transport(
+	const struct gsm_mux_transport *transport);
+void gsm_mux_release(struct gsm_mux *mux);
 int gsm_mux_disconnect(struct gsm_mux *mux, k_timeout_t timeout);
 void gsm_mux_init(void);
 
@@ -36,4 +99,10 @@ int gsm_dlci_create(struct gsm_mux *mux,
 		    struct gsm_dlci **dlci);
 int gsm_dlci_send(struct gsm_dlci *dlci, const uint8_t *buf, size_t size);
 int gsm_dlci_id(struct gsm_dlci *dlci);
+int gsm_mux_timers_get(struct gsm_mux *mux, struct gsm_mux_timers *timers);
+int gsm_mux_stats_get(struct gsm_mux *mux, struct gsm_mux_stats *stats);
+int gsm_dlci_stats_get(struct gsm_dlci *dlci, struct gsm_dlci_stats *stats);
+void gsm_mux_foreach(gsm_mux_foreach_cb_t cb, void *user_data);
+void gsm_mux_dlci_foreach(struct gsm_mux *mux, gsm_dlci_foreach_cb_t cb,
+			  void *user_data);
 void gsm_mux_detach(struct gsm_mux *mux);
@@ -0,0 +1,517 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Loopback benchmark for the GSM 07.10 mux. An initiator and a responder
+ * mux are connected through an in-memory serial line with a configurable
+ * line rate, latency and bit error rate, and mixed PPP and AT traffic is
+ * sent from the initiator to the responder. Meant to be run on native_sim
+ * so that parser and scheduler changes can be compared without hardware.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(gsm_mux_bench, CONFIG_GSM_MUX_LOG_LEVEL);
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/sys/byteorder.h>
+#include <string.h>
+
+#include "gsm_mux.h"
+#include "gsm_mux_bench.h"
+
+#define PIPE_SEGMENTS    64
+#define PIPE_SEGMENT_LEN 64
+
+/* Message header: seq (2), dlci (1), len (1), timestamp in us (4) */
+#define MSG_HDR_LEN      8
+#define MSG_MAX_LEN      MIN(CONFIG_GSM_MUX_MRU_MAX_LEN, 255)
+#define AT_MSG_LEN       32
+
+#define SETUP_TIMEOUT_MS 2000
+
+struct pipe_segment {
+	uint32_t due; /* uptime in us when the data reaches the peer */
+	uint16_t len;
+	uint8_t data[PIPE_SEGMENT_LEN];
+};
+
+/* One direction of the simulated serial line */
+struct bench_pipe {
+	struct k_spinlock lock;
+	struct pipe_segment segs[PIPE_SEGMENTS];
+	uint16_t head;
+	uint16_t tail;
+	uint32_t busy_until; /* line is sending until this time */
+	uint32_t rand;
+	uint32_t bit_errors;
+	uint32_t drops;
+	uint64_t line_bytes;
+	struct gsm_mux *peer;
+};
+
+struct bench_channel {
+	struct gsm_dlci *dlci;
+	atomic_t state; /* 0 opening, 1 connected, -1 failed */
+	uint16_t tx_seq;
+	uint32_t samples;
+	uint32_t latency[CONFIG_GSM_MUX_BENCHMARK_SAMPLES];
+};
+
+static struct {
+	const struct gsm_mux_bench_params *params;
+	struct gsm_mux_bench_result *result;
+	struct gsm_mux_transport transport[2];
+	struct bench_pipe pipe[2]; /* 0: initiator -> responder */
+	struct bench_channel ch[GSM_MUX_BENCH_CHANNELS];
+	struct gsm_dlci *control;
+	atomic_t control_state;
+	struct gsm_mux *mux[2];
+	uint32_t error_threshold;
+	atomic_t busy;
+} bench;
+
+static uint32_t bench_now_us(void)
+{
+	return (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+static uint32_t bench_rand(struct bench_pipe *pipe)
+{
+	uint32_t x = pipe->rand;
+
+	/* xorshift32, so that runs with the same seed are comparable */
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	pipe->rand = x;
+
+	return x;
+}
+
+static void bench_inject_errors(struct bench_pipe *pipe, uint8_t *data,
+				size_t len)
+{
+	size_t i;
+
+	if (bench.error_threshold == 0) {
+		return;
+	}
+
+	for (i = 0; i < len; i++) {
+		if (bench_rand(pipe) < bench.error_threshold) {
+			data[i] ^= BIT(bench_rand(pipe) & 7);
+			pipe->bit_errors++;
+		}
+	}
+}
+
+static int bench_pipe_send(struct gsm_mux *mux, const uint8_t *buf,
+			   size_t size, void *user_data)
+{
+	struct bench_pipe *pipe = user_data;
+	uint32_t now = bench_now_us();
+	struct pipe_segment *seg;
+	k_spinlock_key_t key;
+	size_t sent = 0;
+	uint32_t start;
+	uint16_t len;
+
+	ARG_UNUSED(mux);
+
+	key = k_spin_lock(&pipe->lock);
+
+	while (sent < size) {
+		if ((uint16_t)(pipe->head - pipe->tail) == PIPE_SEGMENTS) {
+			pipe->drops += size - sent;
+			break;
+		}
+
+		seg = &pipe->segs[pipe->head % PIPE_SEGMENTS];
+		len = MIN(size - sent, PIPE_SEGMENT_LEN);
+		memcpy(seg->data, buf + sent, len);
+		bench_inject_errors(pipe, seg->data, len);
+
+		/* Bytes go out back to back at the line rate, 10 bits each */
+		start = (int32_t)(pipe->busy_until - now) > 0 ?
+			pipe->busy_until : now;
+		pipe->busy_until = start +
+			(uint32_t)((uint64_t)len * 10U * USEC_PER_SEC /
+				   bench.params->baudrate);
+
+		seg->due = pipe->busy_until + bench.params->latency_us;
+		seg->len = len;
+		pipe->head++;
+		sent += len;
+	}
+
+	pipe->line_bytes += sent;
+
+	k_spin_unlock(&pipe->lock, key);
+
+	return sent;
+}
+
+/* Feed the data that has reached the other end of the pipe to the peer.
+ * Returns the time in us until the next segment is due.
+ */
+static uint32_t bench_pipe_deliver(struct bench_pipe *pipe)
+{
+	uint8_t data[PIPE_SEGMENT_LEN];
+	struct pipe_segment *seg;
+	k_spinlock_key_t key;
+	uint32_t start, now;
+	uint16_t len;
+
+	while (true) {
+		now = bench_now_us();
+
+		key = k_spin_lock(&pipe->lock);
+
+		if (pipe->head == pipe->tail) {
+			k_spin_unlock(&pipe->lock, key);
+			return UINT32_MAX;
+		}
+
+		seg = &pipe->segs[pipe->tail % PIPE_SEGMENTS];
+		if ((int32_t)(seg->due - now) > 0) {
+			k_spin_unlock(&pipe->lock, key);
+			return seg->due - now;
+		}
+
+		len = seg->len;
+		memcpy(data, seg->data, len);
+		pipe->tail++;
+
+		k_spin_unlock(&pipe->lock, key);
+
+		start = k_cycle_get_32();
+		gsm_mux_recv_buf(pipe->peer, data, len);
+		bench.result->cycles += k_cycle_get_32() - start;
+	}
+}
+
+static uint32_t bench_pump(void)
+{
+	return MIN(bench_pipe_deliver(&bench.pipe[0]),
+		   bench_pipe_deliver(&bench.pipe[1]));
+}
+
+static int bench_channel_index(int dlci_address)
+{
+	if (dlci_address == DLCI_PPP) {
+		return GSM_MUX_BENCH_PPP;
+	}
+
+	if (dlci_address == DLCI_AT) {
+		return GSM_MUX_BENCH_AT;
+	}
+
+	return -1;
+}
+
+static bool bench_msg_valid(const uint8_t *buf, size_t size, int dlci_address)
+{
+	uint16_t seq;
+	size_t i;
+
+	if (size < MSG_HDR_LEN || buf[2] != dlci_address || buf[3] != size) {
+		return false;
+	}
+
+	seq = sys_get_le16(&buf[0]);
+
+	for (i = MSG_HDR_LEN; i < size; i++) {
+		if (buf[i] != (uint8_t)(seq + i)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void bench_recv(struct gsm_mux *mux, int dlci_address,
+		       const uint8_t *buf, size_t size, void *user_data)
+{
+	struct gsm_mux_bench_channel_result *res;
+	struct bench_channel *ch;
+	int idx;
+
+	ARG_UNUSED(user_data);
+
+	idx = bench_channel_index(dlci_address);
+	if (idx < 0 || mux != bench.mux[1]) {
+		return;
+	}
+
+	ch = &bench.ch[idx];
+	res = &bench.result->ch[idx];
+
+	bench.result->frames++;
+
+	/* UIH frames do not protect the payload, so check it here */
+	if (!bench_msg_valid(buf, size, dlci_address)) {
+		res->corrupted++;
+		return;
+	}
+
+	res->received++;
+	res->bytes += size;
+	bench.result->bytes += size;
+
+	ch->latency[ch->samples++ % ARRAY_SIZE(ch->latency)] =
+		bench_now_us() - sys_get_le32(&buf[4]);
+}
+
+static int bench_send_msg(int idx, int dlci_address, size_t len)
+{
+	struct bench_channel *ch = &bench.ch[idx];
+	uint8_t msg[MSG_MAX_LEN];
+	uint32_t start;
+	size_t i;
+	int ret;
+
+	sys_put_le16(ch->tx_seq, &msg[0]);
+	msg[2] = dlci_address;
+	msg[3] = len;
+	sys_put_le32(bench_now_us(), &msg[4]);
+
+	for (i = MSG_HDR_LEN; i < len; i++) {
+		msg[i] = ch->tx_seq + i;
+	}
+
+	start = k_cycle_get_32();
+	ret = gsm_dlci_send(ch->dlci, msg, len);
+	bench.result->cycles += k_cycle_get_32() - start;
+
+	/* Not sent, e.g. out of I frame buffers, try again later */
+	if (ret < 0) {
+		return ret;
+	}
+
+	ch->tx_seq++;
+	bench.result->ch[idx].sent++;
+
+	return 0;
+}
+
+static void bench_dlci_created(struct gsm_dlci *dlci, bool connected,
+			       void *user_data)
+{
+	ARG_UNUSED(dlci);
+
+	atomic_set((atomic_t *)user_data, connected ? 1 : -1);
+}
+
+static int bench_open_dlci(int dlci_address, atomic_t *state,
+			   struct gsm_dlci **dlci)
+{
+	int64_t deadline = k_uptime_get() + SETUP_TIMEOUT_MS;
+	int ret;
+
+	atomic_set(state, 0);
+
+	ret = gsm_dlci_create(bench.mux[0], NULL, dlci_address,
+			      bench_dlci_created, state, dlci);
+	if (ret < 0) {
+		return ret;
+	}
+
+	while (atomic_get(state) == 0 && k_uptime_get() < deadline) {
+		k_sleep(K_USEC(CLAMP(bench_pump(), 1, USEC_PER_MSEC)));
+	}
+
+	if (atomic_get(state) != 1) {
+		LOG_ERR("DLCI %d not connected", dlci_address);
+		return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
+static bool bench_pipe_backlogged(struct bench_pipe *pipe)
+{
+	k_spinlock_key_t key = k_spin_lock(&pipe->lock);
+	bool ret = (uint16_t)(pipe->head - pipe->tail) >= PIPE_SEGMENTS / 2;
+
+	k_spin_unlock(&pipe->lock, key);
+
+	return ret;
+}
+
+static void bench_percentiles(struct bench_channel *ch,
+			      struct gsm_mux_bench_channel_result *res)
+{
+	static const uint8_t pct[] = {
+		[GSM_MUX_BENCH_P50] = 50,
+		[GSM_MUX_BENCH_P90] = 90,
+		[GSM_MUX_BENCH_P99] = 99,
+		[GSM_MUX_BENCH_MAX] = 100,
+	};
+	uint32_t *lat = ch->latency;
+	uint32_t n, i, j, tmp;
+
+	n = MIN(ch->samples, ARRAY_SIZE(ch->latency));
+	if (n == 0) {
+		return;
+	}
+
+	/* Insertion sort, the sample buffer is small */
+	for (i = 1; i < n; i++) {
+		tmp = lat[i];
+
+		for (j = i; j > 0 && lat[j - 1] > tmp; j--) {
+			lat[j] = lat[j - 1];
+		}
+
+		lat[j] = tmp;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(pct); i++) {
+		res->latency_us[i] = lat[(n - 1) * pct[i] / 100];
+	}
+}
+
+static int bench_setup(void)
+{
+	int i, ret;
+
+	for (i = 0; i < ARRAY_SIZE(bench.mux); i++) {
+		bench.pipe[i].rand = bench.params->seed ?
+			bench.params->seed + i : 0x12345678 + i;
+
+		bench.transport[i].send = bench_pipe_send;
+		bench.transport[i].recv = bench_recv;
+		bench.transport[i].user_data = &bench.pipe[i];
+		bench.transport[i].baudrate = bench.params->baudrate;
+		bench.transport[i].is_initiator = i == 0;
+
+		bench.mux[i] = gsm_mux_create_transport(&bench.transport[i]);
+		if (!bench.mux[i]) {
+			LOG_ERR("Cannot create mux, check CONFIG_GSM_MUX_MAX");
+			return -ENOMEM;
+		}
+	}
+
+	bench.pipe[0].peer = bench.mux[1];
+	bench.pipe[1].peer = bench.mux[0];
+
+	ret = bench_open_dlci(DLCI_CONTROL, &bench.control_state,
+			      &bench.control);
+	if (ret < 0) {
+		return ret;
+	}
+
+	for (i = 0; i < GSM_MUX_BENCH_CHANNELS; i++) {
+		ret = bench_open_dlci(i == GSM_MUX_BENCH_PPP ? DLCI_PPP : DLCI_AT,
+				      &bench.ch[i].state, &bench.ch[i].dlci);
+		if (ret < 0) {
+			return ret;
+		}
+	}
+
+	/* Only the traffic is measured, not the connection setup */
+	for (i = 0; i < ARRAY_SIZE(bench.pipe); i++) {
+		bench.pipe[i].bit_errors = 0;
+		bench.pipe[i].drops = 0;
+		bench.pipe[i].line_bytes = 0;
+	}
+
+	return 0;
+}
+
+int gsm_mux_bench_run(const struct gsm_mux_bench_params *params,
+		      struct gsm_mux_bench_result *result)
+{
+	struct gsm_mux_bench_result setup_result;
+	uint32_t ppp_len, now, wait, next_at;
+	int64_t start, deadline;
+	int i, ret;
+
+	if (params->baudrate == 0 || params->duration_ms == 0) {
+		return -EINVAL;
+	}
+
+	if (!atomic_cas(&bench.busy, 0, 1)) {
+		return -EBUSY;
+	}
+
+	gsm_mux_init();
+
+	memset(&bench.pipe, 0, sizeof(bench.pipe));
+	memset(&bench.ch, 0, sizeof(bench.ch));
+	memset(&bench.mux, 0, sizeof(bench.mux));
+	memset(result, 0, sizeof(*result));
+	memset(&setup_result, 0, sizeof(setup_result));
+
+	bench.params = params;
+	bench.result = &setup_result;
+	bench.error_threshold = 0;
+
+	ppp_len = params->ppp_frame_len ? params->ppp_frame_len :
+		CONFIG_GSM_MUX_MRU_DEFAULT_LEN;
+	ppp_len = CLAMP(ppp_len, MSG_HDR_LEN, MSG_MAX_LEN);
+
+	/* Connect over an error free line, errors only hit the traffic */
+	ret = bench_setup();
+	if (ret < 0) {
+		goto out;
+	}
+
+	/* Probability of a bit error within a byte, scaled to 2^32 */
+	bench.error_threshold = MIN((uint64_t)params->ber * 8U *
+				    (1ULL << 32) / 1000000000ULL,
+				    UINT32_MAX);
+	bench.result = result;
+
+	start = k_uptime_get();
+	deadline = start + params->duration_ms;
+	next_at = bench_now_us();
+
+	while (k_uptime_get() < deadline) {
+		wait = bench_pump();
+		now = bench_now_us();
+
+		if (params->at_interval_ms &&
+		    (int32_t)(next_at - now) <= 0) {
+			(void)bench_send_msg(GSM_MUX_BENCH_AT, DLCI_AT,
+					     AT_MSG_LEN);
+			next_at += params->at_interval_ms * USEC_PER_MSEC;
+		}
+
+		if (params->at_interval_ms) {
+			wait = MIN(wait, next_at - now);
+		}
+
+		/* PPP is bulk traffic, keep the line busy */
+		if (!bench_pipe_backlogged(&bench.pipe[0]) &&
+		    bench_send_msg(GSM_MUX_BENCH_PPP, DLCI_PPP, ppp_len) == 0) {
+			continue;
+		}
+
+		k_sleep(K_USEC(CLAMP(wait, 1, USEC_PER_MSEC)));
+	}
+
+	result->elapsed_ms = k_uptime_get() - start;
+
+	for (i = 0; i < ARRAY_SIZE(bench.pipe); i++) {
+		result->bit_errors += bench.pipe[i].bit_errors;
+		result->pipe_drops += bench.pipe[i].drops;
+		result->line_bytes += bench.pipe[i].line_bytes;
+	}
+
+	for (i = 0; i < GSM_MUX_BENCH_CHANNELS; i++) {
+		bench_percentiles(&bench.ch[i], &result->ch[i]);
+	}
+
+out:
+	for (i = 0; i < ARRAY_SIZE(bench.mux); i++) {
+		if (bench.mux[i]) {
+			gsm_mux_release(bench.mux[i]);
+		}
+	}
+
+	atomic_set(&bench.busy, 0);
+
+	return ret;
+}
@@ -0,0 +1,50 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Latency percentiles reported per DLCI */
+enum gsm_mux_bench_pct {
+	GSM_MUX_BENCH_P50,
+	GSM_MUX_BENCH_P90,
+	GSM_MUX_BENCH_P99,
+	GSM_MUX_BENCH_MAX,
+	GSM_MUX_BENCH_PCT_COUNT
+};
+
+enum gsm_mux_bench_channel {
+	GSM_MUX_BENCH_PPP,
+	GSM_MUX_BENCH_AT,
+	GSM_MUX_BENCH_CHANNELS
+};
+
+struct gsm_mux_bench_params {
+	uint32_t duration_ms;
+	uint32_t baudrate;       /* 0 means unlimited */
+	uint32_t latency_us;     /* one way pipe latency */
+	uint32_t ber;            /* bit errors per 10^9 bits */
+	uint32_t at_interval_ms; /* AT command period */
+	uint16_t ppp_frame_len;  /* 0 means MRU */
+	uint32_t seed;
+};
+
+struct gsm_mux_bench_channel_result {
+	uint32_t sent;      /* messages sent */
+	uint32_t received;  /* messages received intact */
+	uint32_t corrupted; /* messages received with payload errors */
+	uint64_t bytes;     /* payload bytes received intact */
+	uint32_t latency_us[GSM_MUX_BENCH_PCT_COUNT];
+};
+
+struct gsm_mux_bench_result {
+	uint32_t elapsed_ms;
+	uint32_t frames;      /* messages received, all channels */
+	uint64_t bytes;       /* payload bytes received intact */
+	uint64_t cycles;      /* CPU cycles spent in the mux */
+	uint64_t line_bytes;  /* bytes sent through the pipe */
+	uint32_t bit_errors;  /* injected bit errors */
+	uint32_t pipe_drops;  /* bytes dropped because the pipe was full */
+	struct gsm_mux_bench_channel_result ch[GSM_MUX_BENCH_CHANNELS];
+};
+
+int gsm_mux_bench_run(const struct gsm_mux_bench_params *params,
+		      struct gsm_mux_bench_result *result);
@@ -183,7 +183,7 @@ static int process_cmd(const struct modem_cmd *cmd, size_t match_len,
 			struct modem_cmd_handler_data *data)
 {
 	int parsed_len = 0, ret = 0;
-	uint8_t *argv[CONFIG_MODEM_CMD_HANDLER_MAX_PARAM_COUNT];
+	uint8_t *argv[CONFIG_MGSM_MODEM_CMD_HANDLER_MAX_PARAM_COUNT];
 	uint16_t argc = 0U;
 
 	/* reset params */
@@ -275,6 +275,21 @@ static int cmd_handler_process_iface_data(struct modem_cmd_handler_data *data,
 	size_t bytes_read = 0;
 	int ret;
 
+	/* take received fragments as they are when the iface supports it */
+	if (iface->read_buf) {
+		struct net_buf *frag;
+
+		while (iface->read_buf(iface, &frag) == 0) {
+			if (!data->rx_buf) {
+				data->rx_buf = frag;
+			} else {
+				net_buf_frag_add(data->rx_buf, frag);
+			}
+		}
+
+		return 0;
+	}
+
 	if (!data->rx_buf) {
 		data->rx_buf = net_buf_alloc(data->buf_pool,
 					     data->alloc_timeout);
@@ -368,7 +383,7 @@ static void cmd_handler_process_rx_buf(struct modem_cmd_handler_data *data)
 				data->match_buf_len - 1, match_len);
 		}
 
-#if defined(CONFIG_MODEM_CONTEXT_VERBOSE_DEBUG)
+#if defined(CONFIG_MGSM_MODEM_CONTEXT_VERBOSE_DEBUG)
 		LOG_HEXDUMP_DBG(data->match_buf, match_len, "RECV");
 #endif
 
@@ -515,7 +530,7 @@ int modem_cmd_send_ext(struct modem_iface *iface,
 		}
 	}
 
-#if defined(CONFIG_MODEM_CONTEXT_VERBOSE_DEBUG)
+#if defined(CONFIG_MGSM_MODEM_CONTEXT_VERBOSE_DEBUG)
 	LOG_HEXDUMP_DBG(buf, strlen(buf), "SENT DATA");
 
 	if (data->eol_len > 0) {
@@ -533,8 +548,11 @@ int modem_cmd_send_ext(struct modem_iface *iface,
 		k_sem_reset(sem);
 	}
 
-	iface->write(iface, buf, strlen(buf));
-	iface->write(iface, data->eol, data->eol_len);
+	/* Command and EOL go out in one write */
+	(void)modem_iface_writev(iface, (struct iovec[]) {
+		{ .iov_base = (void *)buf, .iov_len = strlen(buf) },
+		{ .iov_base = (void *)data->eol, .iov_len = data->eol_len },
+	}, 2);
 
 	if (sem) {
 		ret = k_sem_take(sem, timeout);
@@ -18,7 +18,10 @@ LOG_MODULE_REGISTER(modem_context, CONFIG_MODEM_LOG_LEVEL);
 
 #include "modem_context.h"
 
-static struct modem_context *contexts[CONFIG_MODEM_CONTEXT_MAX_NUM];
+static struct modem_context *contexts[CONFIG_MGSM_MODEM_CONTEXT_MAX_NUM];
+
+/* Protects contexts */
+static struct k_spinlock contexts_lock;
 
 int modem_context_sprint_ip_addr(const struct sockaddr *addr, char *buf, size_t buf_size)
 {
@@ -82,22 +85,32 @@ int modem_context_get_addr_port(const struct sockaddr *addr, uint16_t *port)
  */
 struct modem_context *modem_context_from_iface_dev(const struct device *dev)
 {
+	struct modem_context *ctx = NULL;
+	k_spinlock_key_t key;
 	int i;
 
+	/* The UART ISRs get their context as user data, this lookup is
+	 * only used outside of the data path.
+	 */
+	key = k_spin_lock(&contexts_lock);
+
 	for (i = 0; i < ARRAY_SIZE(contexts); i++) {
 		if (contexts[i] && contexts[i]->iface.dev == dev) {
-			return contexts[i];
+			ctx = contexts[i];
+			break;
 		}
 	}
 
-	return NULL;
+	k_spin_unlock(&contexts_lock, key);
+
+	return ctx;
 }
 
 /**
  * @brief  Assign a modem context if there is free space.
  *
  * @note   Amount of stored modem contexts is determined by
- *         CONFIG_MODEM_CONTEXT_MAX_NUM.
+ *         CONFIG_MGSM_MODEM_CONTEXT_MAX_NUM.
  *
  * @param  *ctx: modem context to persist.
  *
@@ -105,21 +118,29 @@ struct modem_context *modem_context_from_iface_dev(const struct device *dev)
  */
 static int modem_context_get(struct modem_context *ctx)
 {
+	k_spinlock_key_t key;
+	int ret = -ENOMEM;
 	int i;
 
+	key = k_spin_lock(&contexts_lock);
+
 	for (i = 0; i < ARRAY_SIZE(contexts); i++) {
 		if (!contexts[i]) {
 			contexts[i] = ctx;
-			return 0;
+			ret = 0;
+			break;
 		}
 	}
 
-	return -ENOMEM;
+	k_spin_unlock(&contexts_lock, key);
+
+	return ret;
 }
 
 struct modem_context *modem_context_from_id(int id)
 {
 	if (id >= 0 && id < ARRAY_SIZE(contexts)) {
+		/* pointer sized loads are atomic, no lock needed */
 		return contexts[id];
 	} else {
 		return NULL;
@@ -134,3 +155,31 @@ int modem_context_register(struct modem_context *ctx)
 
 	return modem_context_get(ctx);
 }
+
+int modem_iface_writev(struct modem_iface *iface, const struct iovec *iov,
+		       size_t iovcnt)
+{
+	size_t i;
+	int ret;
+
+	if (!iface || !iface->write) {
+		return -EINVAL;
+	}
+
+	if (iface->writev) {
+		return iface->writev(iface, iov, iovcnt);
+	}
+
+	for (i = 0; i < iovcnt; i++) {
+		if (iov[i].iov_len == 0) {
+			continue;
+		}
+
+		ret = iface->write(iface, iov[i].iov_base, iov[i].iov_len);
+		if (ret < 0) {
+			return ret;
+		}
+	}
+
+	return 0;
+}
@@ -30,6 +30,13 @@ struct modem_iface {
 	int (*read)(struct modem_iface *iface, uint8_t *buf, size_t size,
 		    size_t *bytes_read);
 	int (*write)(struct modem_iface *iface, const uint8_t *buf, size_t size);
+	/* optional, use modem_iface_writev() to fall back to write */
+	int (*writev)(struct modem_iface *iface, const struct iovec *iov,
+		      size_t iovcnt);
+	/* optional, hands over received data as a fragment without copying.
+	 * The caller owns the fragment and releases it with net_buf_unref().
+	 */
+	int (*read_buf)(struct modem_iface *iface, struct net_buf **frag);
 
 	/* implementation data */
 	void *iface_data;
@@ -49,11 +56,11 @@ struct modem_context {
 	char *data_model;
 	char *data_revision;
 	char *data_imei;
-#if defined(CONFIG_MODEM_SIM_NUMBERS)
+#if defined(CONFIG_MGSM_MODEM_SIM_NUMBERS)
 	char *data_imsi;
 	char *data_iccid;
 #endif
-#if defined(CONFIG_MODEM_CELL_INFO)
+#if defined(CONFIG_MGSM_MODEM_CELL_INFO)
 	int   data_operator;
 	int   data_lac;
 	int   data_cellid;
@@ -93,6 +100,21 @@ int modem_context_sprint_ip_addr(const struct sockaddr *addr, char *buf, size_t
  */
 int modem_context_get_addr_port(const struct sockaddr *addr, uint16_t *port);
 
+/**
+ * @brief  Writes several buffers to the modem interface.
+ *
+ * @note   Uses the writev operation of the interface if it has one,
+ *         otherwise the buffers are written one after another.
+ *
+ * @param  *iface: modem interface to write to.
+ * @param  *iov: buffers to write.
+ * @param  iovcnt: number of buffers.
+ *
+ * @retval 0 if ok, < 0 if error.
+ */
+int modem_iface_writev(struct modem_iface *iface, const struct iovec *iov,
+		       size_t iovcnt);
+
 /**
  * @brief  Gets modem context by id.
  *
@@ -0,0 +1,465 @@
+/** @file
+ * @brief Simulated modem interface
+ *
+ * In-process modem answering AT commands from a rules table, for running
+ * the modem context drivers without hardware.
+ */
+
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(modem_iface_sim, CONFIG_MODEM_LOG_LEVEL);
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/crc.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "modem_context.h"
+#include "modem_iface_sim.h"
+
+/* Start, stop and parity bits are not emulated, a byte is 10 bits */
+#define BITS_PER_BYTE 10
+
+/* GSM 07.10 basic mode framing, see gsm_mux.c */
+#define SOF_MARKER     0xF9
+#define FCS_POLYNOMIAL 0xe0
+#define FCS_INIT_VALUE 0xFF
+#define GSM_EA         0x01
+#define GSM_CR         0x02
+#define GSM_PF         0x10
+#define FT_DM          0x0F
+#define FT_SABM        0x2F
+#define FT_DISC        0x43
+#define FT_UA          0x63
+#define FT_UIH         0xEF
+#define CMD_CLD        0x60
+
+#define DLCI_CONTROL   0
+
+K_KERNEL_STACK_DEFINE(modem_iface_sim_stack, CONFIG_MGSM_MODEM_IFACE_SIM_STACK_SIZE);
+
+static bool sim_running;
+
+/**
+ * @brief  Waits for the time the emulated line needs for the data.
+ *
+ * @param  *data: simulated modem data.
+ * @param  len: number of bytes.
+ *
+ * @retval None.
+ */
+static void sim_line_delay(struct modem_iface_sim_data *data, size_t len)
+{
+	uint32_t baudrate = data->config.baudrate;
+
+	if (baudrate > 0 && len > 0) {
+		k_sleep(K_USEC(((uint64_t)len * BITS_PER_BYTE * USEC_PER_SEC) / baudrate));
+	}
+}
+
+static void sim_output(struct modem_iface_sim_data *data, const uint8_t *buf, size_t len)
+{
+	uint32_t written;
+
+	sim_line_delay(data, len);
+
+	written = ring_buf_put(&data->rx_rb, buf, len);
+	if (written != len) {
+		LOG_WRN("Host is not reading, %zu bytes dropped", len - written);
+	}
+
+	k_sem_give(&data->rx_sem);
+}
+
+static void sim_send_frame(struct modem_iface_sim_data *data, uint8_t dlci,
+			   bool cr, uint8_t control, const uint8_t *buf, size_t len)
+{
+	uint8_t hdr[5];
+	uint8_t tail[2];
+	size_t pos;
+	uint8_t fcs;
+
+	/* Frames longer than the 1 byte length field are split */
+	do {
+		size_t chunk = MIN(len, 127);
+
+		pos = 0;
+		hdr[pos++] = SOF_MARKER;
+		hdr[pos++] = (dlci << 2) | (cr ? GSM_CR : 0) | GSM_EA;
+		hdr[pos++] = control;
+		hdr[pos++] = (chunk << 1) | GSM_EA;
+
+		fcs = crc8(&hdr[1], pos - 1, FCS_POLYNOMIAL, FCS_INIT_VALUE, true);
+		if (control != FT_UIH) {
+			fcs = crc8(buf, chunk, FCS_POLYNOMIAL, fcs, true);
+		}
+
+		tail[0] = 0xFF - fcs;
+		tail[1] = SOF_MARKER;
+
+		sim_output(data, hdr, pos);
+		sim_output(data, buf, chunk);
+		sim_output(data, tail, sizeof(tail));
+
+		buf += chunk;
+		len -= chunk;
+	} while (len > 0);
+}
+
+/**
+ * @brief  Sends text to the host, framed when in CMUX mode.
+ */
+static void sim_reply(struct modem_iface_sim_data *data, const char *text)
+{
+	if (!text) {
+		return;
+	}
+
+	if (data->cmux) {
+		/* Data from the responder is a command, C/R cleared */
+		sim_send_frame(data, data->line_dlci, false, FT_UIH,
+			       (const uint8_t *)text, strlen(text));
+	} else {
+		sim_output(data, (const uint8_t *)text, strlen(text));
+	}
+}
+
+static const struct modem_iface_sim_rule *sim_find_rule(struct modem_iface_sim_data *data,
+							const char *line)
+{
+	const struct modem_iface_sim_config *config = &data->config;
+	size_t i;
+
+	for (i = 0; i < config->rules_len; i++) {
+		const char *cmd = config->rules[i].cmd;
+
+		if (strncmp(line, cmd, strlen(cmd)) == 0) {
+			return &config->rules[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Length of the data following a command, its last number */
+static size_t sim_data_len(const char *line)
+{
+	const char *p = strrchr(line, ',');
+
+	if (!p) {
+		p = strchr(line, '=');
+	}
+
+	return p ? strtoul(p + 1, NULL, 10) : 0;
+}
+
+static void sim_process_line(struct modem_iface_sim_data *data)
+{
+	const struct modem_iface_sim_rule *rule;
+
+	data->line[data->line_len] = '\0';
+	data->line_len = 0;
+
+	if (data->line[0] == '\0') {
+		return;
+	}
+
+	rule = sim_find_rule(data, data->line);
+
+	k_sleep(K_MSEC(data->config.latency_ms + (rule ? rule->delay_ms : 0)));
+
+	if (!rule) {
+		LOG_DBG("No rule for \"%s\"", data->line);
+		sim_reply(data, data->config.no_match);
+		return;
+	}
+
+	sim_reply(data, rule->response);
+
+	if (rule->data_response) {
+		data->data_left = sim_data_len(data->line);
+		if (data->data_left == 0) {
+			sim_reply(data, rule->data_response);
+		} else {
+			data->data_rule = rule;
+		}
+	}
+
+	if (rule->cmux && !data->cmux) {
+		LOG_DBG("Entering CMUX mode");
+		data->cmux = true;
+		data->frame_len = 0;
+	}
+}
+
+static void sim_process_at(struct modem_iface_sim_data *data, uint8_t dlci,
+			   const uint8_t *buf, size_t len)
+{
+	size_t i;
+
+	data->line_dlci = dlci;
+
+	for (i = 0; i < len; i++) {
+		if (data->data_left > 0) {
+			/* data of the last command, not parsed */
+			if (--data->data_left == 0) {
+				sim_reply(data, data->data_rule->data_response);
+				data->data_rule = NULL;
+			}
+		} else if (buf[i] == '\r') {
+			sim_process_line(data);
+		} else if (buf[i] != '\n' && data->line_len < sizeof(data->line) - 1) {
+			data->line[data->line_len++] = buf[i];
+		}
+	}
+}
+
+static void sim_process_control(struct modem_iface_sim_data *data,
+				uint8_t *msg, size_t len)
+{
+	uint8_t type;
+
+	if (len < 2 || !(msg[0] & GSM_CR)) {
+		/* Responses to our commands, none are sent */
+		return;
+	}
+
+	type = msg[0] & ~(GSM_CR | GSM_EA);
+
+	/* Every command is answered with its own content */
+	msg[0] &= ~GSM_CR;
+	sim_send_frame(data, DLCI_CONTROL, false, FT_UIH, msg, len);
+
+	if (type == CMD_CLD) {
+		LOG_DBG("Leaving CMUX mode");
+		data->cmux = false;
+	}
+}
+
+static void sim_process_frame(struct modem_iface_sim_data *data)
+{
+	uint8_t *frame = data->frame;
+	size_t n = data->frame_len;
+	size_t hdr_len = 3;
+	uint8_t dlci, control;
+	size_t len;
+	uint8_t fcs;
+
+	data->frame_len = 0;
+
+	if (n < 4) {
+		return;
+	}
+
+	dlci = frame[0] >> 2;
+	control = frame[1] & ~GSM_PF;
+	len = frame[2] >> 1;
+	if (!(frame[2] & GSM_EA)) {
+		len |= frame[3] << 7;
+		hdr_len = 4;
+	}
+
+	if (hdr_len + len + 1 != n) {
+		LOG_DBG("Bad frame length %zu", n);
+		return;
+	}
+
+	fcs = crc8(frame, hdr_len, FCS_POLYNOMIAL, FCS_INIT_VALUE, true);
+	if (control != FT_UIH) {
+		fcs = crc8(&frame[hdr_len], len, FCS_POLYNOMIAL, fcs, true);
+	}
+
+	if ((uint8_t)(0xFF - fcs) != frame[n - 1]) {
+		LOG_DBG("Bad FCS on DLCI %d", dlci);
+		return;
+	}
+
+	switch (control) {
+	case FT_SABM:
+		sim_send_frame(data, dlci, true, FT_UA | GSM_PF, NULL, 0);
+		break;
+	case FT_DISC:
+		sim_send_frame(data, dlci, true, FT_UA | GSM_PF, NULL, 0);
+		if (dlci == DLCI_CONTROL) {
+			LOG_DBG("Leaving CMUX mode");
+			data->cmux = false;
+		}
+		break;
+	case FT_UIH:
+		if (dlci == DLCI_CONTROL) {
+			sim_process_control(data, &frame[hdr_len], len);
+		} else {
+			sim_process_at(data, dlci, &frame[hdr_len], len);
+		}
+		break;
+	default:
+		sim_send_frame(data, dlci, true, FT_DM | GSM_PF, NULL, 0);
+		break;
+	}
+}
+
+static void sim_process_cmux(struct modem_iface_sim_data *data,
+			     const uint8_t *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len && data->cmux; i++) {
+		if (buf[i] == SOF_MARKER) {
+			/* Closing flag, or a repeated opening one */
+			if (data->frame_len > 0) {
+				sim_process_frame(data);
+			}
+			continue;
+		}
+
+		if (data->frame_len < sizeof(data->frame)) {
+			data->frame[data->frame_len++] = buf[i];
+		}
+	}
+
+	/* Left CMUX mode, the rest is AT commands */
+	if (i < len) {
+		sim_process_at(data, 0, &buf[i], len - i);
+	}
+}
+
+static void sim_send_urcs(struct modem_iface_sim_data *data)
+{
+	atomic_val_t pending = atomic_set(&data->urc_pending, 0);
+	size_t i;
+
+	for (i = 0; i < data->config.urcs_len; i++) {
+		if (pending & BIT(i)) {
+			data->line_dlci = data->cmux ? CONFIG_MGSM_MODEM_IFACE_SIM_URC_DLCI : 0;
+			sim_reply(data, data->config.urcs[i].text);
+		}
+	}
+}
+
+static void sim_urc_expiry(struct k_timer *timer)
+{
+	struct modem_iface_sim_data *data = k_timer_user_data_get(timer);
+	size_t idx = timer - data->urc_timers;
+
+	atomic_or(&data->urc_pending, BIT(idx));
+	k_sem_give(&data->work_sem);
+}
+
+static void sim_thread(void *p1, void *p2, void *p3)
+{
+	struct modem_iface_sim_data *data = p1;
+	uint8_t buf[32];
+	uint32_t len;
+
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	while (true) {
+		k_sem_take(&data->work_sem, K_FOREVER);
+
+		sim_send_urcs(data);
+
+		while ((len = ring_buf_get(&data->tx_rb, buf, sizeof(buf))) > 0) {
+			k_sem_give(&data->tx_space_sem);
+			sim_line_delay(data, len);
+
+			if (data->cmux) {
+				sim_process_cmux(data, buf, len);
+			} else {
+				sim_process_at(data, 0, buf, len);
+			}
+		}
+	}
+}
+
+static int modem_iface_sim_read(struct modem_iface *iface,
+				uint8_t *buf, size_t size, size_t *bytes_read)
+{
+	struct modem_iface_sim_data *data;
+
+	if (!iface || !iface->iface_data) {
+		return -EINVAL;
+	}
+
+	data = iface->iface_data;
+	*bytes_read = ring_buf_get(&data->rx_rb, buf, size);
+
+	return 0;
+}
+
+static int modem_iface_sim_write(struct modem_iface *iface,
+				 const uint8_t *buf, size_t size)
+{
+	struct modem_iface_sim_data *data;
+	uint32_t written;
+
+	if (!iface || !iface->iface_data) {
+		return -EINVAL;
+	}
+
+	data = iface->iface_data;
+
+	/* The modem thread consumes the data at the emulated line rate */
+	while (size > 0) {
+		written = ring_buf_put(&data->tx_rb, buf, size);
+		buf += written;
+		size -= written;
+
+		k_sem_give(&data->work_sem);
+
+		if (size > 0) {
+			k_sem_take(&data->tx_space_sem, K_FOREVER);
+		}
+	}
+
+	return 0;
+}
+
+int modem_iface_sim_init(struct modem_iface *iface, struct modem_iface_sim_data *data,
+			 const struct modem_iface_sim_config *config)
+{
+	size_t i;
+
+	if (!iface || !data || !config ||
+	    config->urcs_len > CONFIG_MGSM_MODEM_IFACE_SIM_MAX_URCS) {
+		return -EINVAL;
+	}
+
+	if (sim_running) {
+		return -EALREADY;
+	}
+
+	sim_running = true;
+
+	memset(data, 0, sizeof(*data));
+	data->config = *config;
+
+	ring_buf_init(&data->rx_rb, config->rx_rb_buf_len, config->rx_rb_buf);
+	ring_buf_init(&data->tx_rb, config->tx_rb_buf_len, config->tx_rb_buf);
+	k_sem_init(&data->rx_sem, 0, 1);
+	k_sem_init(&data->tx_space_sem, 0, 1);
+	k_sem_init(&data->work_sem, 0, 1);
+
+	iface->dev = NULL;
+	iface->iface_data = data;
+	iface->read = modem_iface_sim_read;
+	iface->write = modem_iface_sim_write;
+
+	(void)k_thread_create(&data->thread, modem_iface_sim_stack,
+			      K_KERNEL_STACK_SIZEOF(modem_iface_sim_stack),
+			      sim_thread, data, NULL, NULL,
+			      K_PRIO_COOP(CONFIG_MGSM_MODEM_IFACE_SIM_THREAD_PRIO), 0, K_NO_WAIT);
+	(void)k_thread_name_set(&data->thread, "modem_sim");
+
+	for (i = 0; i < config->urcs_len; i++) {
+		k_timer_init(&data->urc_timers[i], sim_urc_expiry, NULL);
+		k_timer_user_data_set(&data->urc_timers[i], data);
+		k_timer_start(&data->urc_timers[i], K_MSEC(config->urcs[i].period_ms),
+			      K_MSEC(config->urcs[i].period_ms));
+	}
+
+	return 0;
+}
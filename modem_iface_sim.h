@@ -0,0 +1,157 @@
+/** @file
+ * @brief Simulated modem interface header file.
+ *
+ * Scripted in-process modem for running the modem drivers without
+ * hardware, e.g. on native_sim.
+ */
+
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ZEPHYR_INCLUDE_DRIVERS_MODEM_MODEM_IFACE_SIM_H_
+#define ZEPHYR_INCLUDE_DRIVERS_MODEM_MODEM_IFACE_SIM_H_
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/ring_buffer.h>
+
+#include "modem_context.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Reply rule of the simulated modem
+ *
+ * @param cmd Command prefix to match, without EOL
+ * @param response Text sent back, including line endings, or NULL
+ * @param delay_ms Response latency added to the global one
+ * @param cmux Enter CMUX mode after the response
+ * @param data_response If not NULL, the command is followed by as many data
+ *        bytes as its last number says, e.g. AT+QISEND=0,5. They are
+ *        skipped and this text is sent after them.
+ */
+struct modem_iface_sim_rule {
+	const char *cmd;
+	const char *response;
+	uint32_t delay_ms;
+	bool cmux;
+	const char *data_response;
+};
+
+/**
+ * @brief Unsolicited result code sent periodically
+ *
+ * @param text Text sent, including line endings
+ * @param period_ms Period of the URC
+ */
+struct modem_iface_sim_urc {
+	const char *text;
+	uint32_t period_ms;
+};
+
+/**
+ * @brief Simulated modem configuration
+ *
+ * @param rules Reply rules, the first matching rule is used
+ * @param rules_len Number of reply rules
+ * @param urcs URCs, at most CONFIG_MGSM_MODEM_IFACE_SIM_MAX_URCS
+ * @param urcs_len Number of URCs
+ * @param no_match Text sent for commands without a rule, or NULL
+ * @param latency_ms Response latency of every command
+ * @param baudrate Emulated line rate, 0 for unlimited
+ * @param rx_rb_buf Buffer for data sent by the modem
+ * @param rx_rb_buf_len Size of rx_rb_buf
+ * @param tx_rb_buf Buffer for data sent to the modem
+ * @param tx_rb_buf_len Size of tx_rb_buf
+ */
+struct modem_iface_sim_config {
+	const struct modem_iface_sim_rule *rules;
+	size_t rules_len;
+	const struct modem_iface_sim_urc *urcs;
+	size_t urcs_len;
+	const char *no_match;
+	uint32_t latency_ms;
+	uint32_t baudrate;
+	char *rx_rb_buf;
+	size_t rx_rb_buf_len;
+	char *tx_rb_buf;
+	size_t tx_rb_buf_len;
+};
+
+struct modem_iface_sim_data {
+	/* copy of the configuration passed to modem_iface_sim_init() */
+	struct modem_iface_sim_config config;
+
+	/* data from the modem, read by the host */
+	struct ring_buf rx_rb;
+	struct k_sem rx_sem;
+
+	/* data to the modem, given when the modem thread frees space */
+	struct ring_buf tx_rb;
+	struct k_sem tx_space_sem;
+
+	/* wakes the modem thread */
+	struct k_sem work_sem;
+
+	/* URC timers set bits in urc_pending */
+	struct k_timer urc_timers[CONFIG_MGSM_MODEM_IFACE_SIM_MAX_URCS];
+	atomic_t urc_pending;
+
+	/* command line being received */
+	char line[CONFIG_MGSM_MODEM_IFACE_SIM_LINE_LEN];
+	size_t line_len;
+	uint8_t line_dlci;
+
+	/* data bytes following the command of data_rule */
+	const struct modem_iface_sim_rule *data_rule;
+	size_t data_left;
+
+	/* CMUX mode and frame being received */
+	bool cmux;
+	uint8_t frame[CONFIG_MGSM_MODEM_IFACE_SIM_FRAME_LEN];
+	size_t frame_len;
+
+	struct k_thread thread;
+};
+
+/**
+ * @brief Initialize simulated modem interface
+ *
+ * @note Only one simulated modem can be started. The configuration is
+ * copied, the tables and buffers it points to must stay valid.
+ *
+ * @param iface Interface structure to initialize
+ * @param data Simulated modem data
+ * @param config Simulated modem configuration
+ *
+ * @return -EINVAL if any argument is invalid
+ * @return -EALREADY if a simulated modem is already running
+ * @return 0 if successful
+ */
+int modem_iface_sim_init(struct modem_iface *iface, struct modem_iface_sim_data *data,
+			 const struct modem_iface_sim_config *config);
+
+/**
+ * @brief Wait for rx data ready from the simulated modem
+ *
+ * @param iface Interface to wait on
+ * @param timeout Maximum time to wait
+ *
+ * @return 0 if data is ready
+ * @return -EBUSY if returned without waiting
+ * @return -EAGAIN if timeout occurred
+ */
+static inline int modem_iface_sim_rx_wait(struct modem_iface *iface, k_timeout_t timeout)
+{
+	struct modem_iface_sim_data *data = (struct modem_iface_sim_data *)iface->iface_data;
+
+	return k_sem_take(&data->rx_sem, timeout);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ZEPHYR_INCLUDE_DRIVERS_MODEM_MODEM_IFACE_SIM_H_ */
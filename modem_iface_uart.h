@@ -29,12 +29,82 @@ struct modem_iface_uart_data {
 	/* rx semaphore */
 	struct k_sem rx_sem;
 
-#ifdef CONFIG_MODEM_IFACE_UART_ASYNC
+	/* tx done semaphore, given when all queued tx data is sent */
+	struct k_sem tx_done_sem;
 
-	/* tx semaphore */
-	struct k_sem tx_sem;
+#ifdef CONFIG_MGSM_MODEM_IFACE_UART_ASYNC
 
-#endif /* CONFIG_MODEM_IFACE_UART_ASYNC */
+	/* tx queue of slab blocks, the head is being sent by the UART */
+	sys_slist_t tx_queue;
+
+	/* protects tx_queue and tx_err, shared with the UART callback */
+	struct k_spinlock tx_lock;
+
+	/* error of an aborted transmission, reported by the next write */
+	int tx_err;
+
+#ifdef CONFIG_MGSM_MODEM_IFACE_UART_ASYNC_RX_ZERO_COPY
+	/* received fragments referencing the DMA buffers */
+	struct k_fifo rx_fifo;
+#endif
+
+#else
+
+	/* tx ring buffer, drained from the tx ready interrupt */
+	struct ring_buf tx_rb;
+
+	/* tx space semaphore, given when the ISR frees tx_rb space */
+	struct k_sem tx_space_sem;
+
+	/* set while the tx interrupt runs, until the UART has shifted out
+	 * the last byte
+	 */
+	bool tx_active;
+
+	/* hw flow control: rx pauses at rx_high bytes in rx_rb and
+	 * resumes once the reader drains it to rx_low bytes
+	 */
+	uint32_t rx_high;
+	uint32_t rx_low;
+	bool rx_paused;
+
+	/* hw flow control statistics */
+	uint32_t rx_pause_count;
+	uint32_t rx_paused_ms;
+	uint32_t rx_pause_start;
+
+	/* rx coalescing: the reader is woken once rx_pending reaches
+	 * CONFIG_MGSM_MODEM_IFACE_UART_RX_COALESCE_BYTES or the line is idle
+	 */
+	struct k_timer rx_idle_timer;
+	struct k_spinlock rx_lock;
+	uint32_t rx_pending;
+	uint32_t rx_pending_start;
+
+	/* rx statistics, wake delay is from first pending byte to wakeup */
+	uint64_t rx_bytes;
+	uint32_t rx_wakeups;
+	uint32_t rx_idle_wakeups;
+	uint64_t rx_wake_delay_us_sum;
+	uint32_t rx_wake_delay_us_max;
+
+#endif /* CONFIG_MGSM_MODEM_IFACE_UART_ASYNC */
+};
+
+/** Receive statistics of a UART modem interface */
+struct modem_iface_uart_stats {
+	/** times hw flow control paused the sender */
+	uint32_t rx_pause_count;
+	/** time the sender was paused, including a pause in progress */
+	uint32_t rx_paused_ms;
+	/** bytes received */
+	uint64_t rx_bytes;
+	/** reader wakeups, and those of them by the idle line timer */
+	uint32_t rx_wakeups;
+	uint32_t rx_idle_wakeups;
+	/** delay from the first pending byte to the reader wakeup */
+	uint32_t rx_wake_delay_us_avg;
+	uint32_t rx_wake_delay_us_max;
 };
 
 /**
@@ -55,12 +125,18 @@ int modem_iface_uart_init_dev(struct modem_iface *iface,
  *
  * @param rx_rb_buf Buffer used for internal ring buffer
  * @param rx_rb_buf_len Size of buffer used for internal ring buffer
+ * @param tx_rb_buf Buffer used for interrupt driven transmit, optional.
+ *        If not given, data is sent with uart_poll_out().
+ *        Not used by the async backend.
+ * @param tx_rb_buf_len Size of buffer used for interrupt driven transmit
  * @param dev UART device used for interface
  * @param hw_flow_control Set if hardware flow control is used
  */
 struct modem_iface_uart_config {
 	char *rx_rb_buf;
 	size_t rx_rb_buf_len;
+	char *tx_rb_buf;
+	size_t tx_rb_buf_len;
 	const struct device *dev;
 	bool hw_flow_control;
 };
@@ -94,6 +170,34 @@ static inline int modem_iface_uart_rx_wait(struct modem_iface *iface, k_timeout_
 	return k_sem_take(&data->rx_sem, timeout);
 }
 
+/**
+ * @brief Wait until the data written to the uart interface has been sent
+ *
+ * @details Writes may return before the data is on the line. Use this
+ * when the caller needs to know that, e.g. before changing the baudrate.
+ *
+ * @param iface Interface to wait on
+ * @param timeout Maximum time to wait
+ *
+ * @return 0 if all data has been sent on the line
+ * @return -EINVAL if the interface is not initialized
+ * @return -EAGAIN if timeout occurred
+ */
+int modem_iface_uart_tx_wait(struct modem_iface *iface, k_timeout_t timeout);
+
+/**
+ * @brief Get the receive statistics of a uart interface
+ *
+ * @param iface Interface to get the statistics of
+ * @param stats Destination of the statistics since the interface was initialized
+ *
+ * @return 0 if successful
+ * @return -EINVAL if iface is not an initialized uart interface
+ * @return -ENOTSUP if the backend does not keep statistics
+ */
+int modem_iface_uart_stats_get(struct modem_iface *iface,
+			       struct modem_iface_uart_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
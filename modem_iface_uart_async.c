@@ -8,16 +8,162 @@
 #include <zephyr/logging/log.h>
 #include <zephyr/kernel.h>
 #include <zephyr/drivers/uart.h>
+#include <zephyr/net/buf.h>
 
 #include "modem_context.h"
 #include "modem_iface_uart.h"
 
 LOG_MODULE_REGISTER(modem_iface_uart_async, CONFIG_MODEM_LOG_LEVEL);
 
-#define RX_BUFFER_SIZE CONFIG_MODEM_IFACE_UART_ASYNC_RX_BUFFER_SIZE
-#define RX_BUFFER_NUM CONFIG_MODEM_IFACE_UART_ASYNC_RX_NUM_BUFFERS
+#define RX_BUFFER_SIZE CONFIG_MGSM_MODEM_IFACE_UART_ASYNC_RX_BUFFER_SIZE
+#define RX_BUFFER_NUM CONFIG_MGSM_MODEM_IFACE_UART_ASYNC_RX_NUM_BUFFERS
 
-K_MEM_SLAB_DEFINE(uart_modem_async_rx_slab, RX_BUFFER_SIZE, RX_BUFFER_NUM, 1);
+#define TX_BUFFER_SIZE CONFIG_MGSM_MODEM_IFACE_UART_ASYNC_TX_BUFFER_SIZE
+#define TX_BUFFER_NUM CONFIG_MGSM_MODEM_IFACE_UART_ASYNC_TX_NUM_BUFFERS
+
+/* TX slab block, the descriptor is kept in front of the data */
+struct tx_block {
+	sys_snode_t node;
+	size_t len;
+	uint8_t data[TX_BUFFER_SIZE];
+};
+
+/* RX slab block, references are held by the UART driver and by RX
+ * fragments handed to the reader.
+ */
+struct rx_block {
+	atomic_t ref;
+	bool heap;
+	uint8_t data[RX_BUFFER_SIZE];
+};
+
+K_MEM_SLAB_DEFINE(uart_modem_async_rx_slab, ROUND_UP(sizeof(struct rx_block), 4),
+		  RX_BUFFER_NUM, 4);
+
+#if CONFIG_MGSM_MODEM_IFACE_UART_ASYNC_RX_HEAP_SIZE > 0
+/* Overflow blocks when the slab runs dry, freed again once released */
+K_HEAP_DEFINE(uart_modem_async_rx_heap, CONFIG_MGSM_MODEM_IFACE_UART_ASYNC_RX_HEAP_SIZE);
+#endif
+
+#ifdef CONFIG_MGSM_MODEM_IFACE_UART_ASYNC_RX_ZERO_COPY
+static void rx_frag_destroy(struct net_buf *buf);
+
+NET_BUF_POOL_DEFINE(uart_modem_async_rx_frag_pool,
+		    CONFIG_MGSM_MODEM_IFACE_UART_ASYNC_RX_NUM_FRAGS, 0,
+		    sizeof(struct rx_block *), rx_frag_destroy);
+#endif
+K_MEM_SLAB_DEFINE(uart_modem_async_tx_slab, ROUND_UP(sizeof(struct tx_block), 4),
+		  TX_BUFFER_NUM, 4);
+
+static struct rx_block *rx_block_alloc(k_timeout_t timeout)
+{
+	struct rx_block *block;
+
+	if (k_mem_slab_alloc(&uart_modem_async_rx_slab, (void **)&block, K_NO_WAIT) == 0) {
+		block->heap = false;
+		goto out;
+	}
+
+#if CONFIG_MGSM_MODEM_IFACE_UART_ASYNC_RX_HEAP_SIZE > 0
+	block = k_heap_alloc(&uart_modem_async_rx_heap, sizeof(*block), K_NO_WAIT);
+	if (block) {
+		LOG_DBG("RX slab empty, using heap block");
+		block->heap = true;
+		goto out;
+	}
+#endif
+
+	if (K_TIMEOUT_EQ(timeout, K_NO_WAIT) ||
+	    k_mem_slab_alloc(&uart_modem_async_rx_slab, (void **)&block, timeout) < 0) {
+		return NULL;
+	}
+
+	block->heap = false;
+
+out:
+	atomic_set(&block->ref, 1);
+	return block;
+}
+
+static void rx_block_unref(struct rx_block *block)
+{
+	if (atomic_dec(&block->ref) != 1) {
+		return;
+	}
+
+#if CONFIG_MGSM_MODEM_IFACE_UART_ASYNC_RX_HEAP_SIZE > 0
+	if (block->heap) {
+		k_heap_free(&uart_modem_async_rx_heap, block);
+		return;
+	}
+#endif
+
+	k_mem_slab_free(&uart_modem_async_rx_slab, (void **)&block);
+}
+
+#ifdef CONFIG_MGSM_MODEM_IFACE_UART_ASYNC_RX_ZERO_COPY
+static void rx_frag_destroy(struct net_buf *buf)
+{
+	struct rx_block *block = *(struct rx_block **)net_buf_user_data(buf);
+
+	net_buf_destroy(buf);
+	rx_block_unref(block);
+}
+
+/* Wraps received data in a fragment referencing the DMA block */
+static int rx_frag_queue(struct modem_iface_uart_data *data,
+			 uint8_t *buf, size_t len)
+{
+	struct rx_block *block = CONTAINER_OF(buf, struct rx_block, data);
+	struct net_buf *frag;
+
+	frag = net_buf_alloc_with_data(&uart_modem_async_rx_frag_pool,
+				       buf, len, K_NO_WAIT);
+	if (!frag) {
+		return -ENOMEM;
+	}
+
+	atomic_inc(&block->ref);
+	*(struct rx_block **)net_buf_user_data(frag) = block;
+	k_fifo_put(&data->rx_fifo, frag);
+
+	return 0;
+}
+#endif /* CONFIG_MGSM_MODEM_IFACE_UART_ASYNC_RX_ZERO_COPY */
+
+/* Called with tx_lock held */
+static void tx_start_next(const struct device *dev,
+			  struct modem_iface_uart_data *data)
+{
+	struct tx_block *block;
+	int rc;
+
+	while ((block = (struct tx_block *)sys_slist_peek_head(&data->tx_queue))) {
+		rc = uart_tx(dev, block->data, block->len, SYS_FOREVER_MS);
+		if (rc == 0) {
+			return;
+		}
+
+		LOG_ERR("Failed to start TX: %d", rc);
+		data->tx_err = rc;
+		sys_slist_get(&data->tx_queue);
+		k_mem_slab_free(&uart_modem_async_tx_slab, (void **)&block);
+	}
+
+	k_sem_give(&data->tx_done_sem);
+}
+
+/* Called with tx_lock held */
+static void tx_drop_all(struct modem_iface_uart_data *data)
+{
+	sys_snode_t *node;
+
+	while ((node = sys_slist_get(&data->tx_queue))) {
+		k_mem_slab_free(&uart_modem_async_tx_slab, (void **)&node);
+	}
+
+	k_sem_give(&data->tx_done_sem);
+}
 
 static void iface_uart_async_callback(const struct device *dev,
 				      struct uart_event *evt,
@@ -25,32 +171,58 @@ static void iface_uart_async_callback(const struct device *dev,
 {
 	struct modem_iface *iface = user_data;
 	struct modem_iface_uart_data *data = iface->iface_data;
+	struct rx_block *block;
+	k_spinlock_key_t key;
+	sys_snode_t *node;
 	uint32_t written;
-	void *buf;
-	int rc;
 
 	switch (evt->type) {
 	case UART_TX_DONE:
-		k_sem_give(&data->tx_sem);
+		/* Release the sent block and keep the line busy */
+		key = k_spin_lock(&data->tx_lock);
+		node = sys_slist_get(&data->tx_queue);
+		if (node) {
+			k_mem_slab_free(&uart_modem_async_tx_slab, (void **)&node);
+		}
+		tx_start_next(dev, data);
+		k_spin_unlock(&data->tx_lock, key);
+		break;
+	case UART_TX_ABORTED:
+		/* Data after the aborted block is stale as well */
+		LOG_WRN("TX aborted, %zu bytes sent", evt->data.tx.len);
+		key = k_spin_lock(&data->tx_lock);
+		data->tx_err = -EIO;
+		tx_drop_all(data);
+		k_spin_unlock(&data->tx_lock, key);
 		break;
 	case UART_RX_BUF_REQUEST:
 		/* Allocate next RX buffer for UART driver */
-		rc = k_mem_slab_alloc(&uart_modem_async_rx_slab, (void **)&buf, K_NO_WAIT);
-		if (rc < 0) {
-			/* Major problems, UART_RX_BUF_RELEASED event is not being generated, or
-			 * CONFIG_MODEM_IFACE_UART_ASYNC_RX_NUM_BUFFERS is not large enough.
+		block = rx_block_alloc(K_NO_WAIT);
+		if (!block) {
+			/* Major problems, UART_RX_BUF_RELEASED event is not being generated,
+			 * the reader holds on to received fragments, or the slab and
+			 * CONFIG_MGSM_MODEM_IFACE_UART_ASYNC_RX_HEAP_SIZE are not large enough.
 			 */
 			LOG_ERR("RX buffer starvation");
 			break;
 		}
 		/* Provide the buffer to the UART driver */
-		uart_rx_buf_rsp(dev, buf, RX_BUFFER_SIZE);
+		uart_rx_buf_rsp(dev, block->data, RX_BUFFER_SIZE);
 		break;
 	case UART_RX_BUF_RELEASED:
-		/* UART driver is done with memory, free it */
-		k_mem_slab_free(&uart_modem_async_rx_slab, (void **)&evt->data.rx_buf.buf);
+		/* UART driver is done with memory, drop its reference */
+		rx_block_unref(CONTAINER_OF(evt->data.rx_buf.buf, struct rx_block, data));
 		break;
 	case UART_RX_RDY:
+#ifdef CONFIG_MGSM_MODEM_IFACE_UART_ASYNC_RX_ZERO_COPY
+		/* Hand the data to the reader without copying */
+		if (rx_frag_queue(data, evt->data.rx.buf + evt->data.rx.offset,
+				  evt->data.rx.len) < 0) {
+			LOG_WRN("Received bytes dropped, no RX fragment");
+		}
+		k_sem_give(&data->rx_sem);
+		break;
+#endif
 		/* Place received data on the ring buffer */
 		written = ring_buf_put(&data->rx_rb,
 				       evt->data.rx.buf + evt->data.rx.offset,
@@ -80,41 +252,177 @@ static int modem_iface_uart_async_read(struct modem_iface *iface,
 		return 0;
 	}
 
-	/* Pull data off the ring buffer */
 	data = iface->iface_data;
+
+#ifdef CONFIG_MGSM_MODEM_IFACE_UART_ASYNC_RX_ZERO_COPY
+	/* Copy out of the queued fragments for readers wanting a buffer */
+	*bytes_read = 0;
+	while (*bytes_read < size) {
+		struct net_buf *frag = k_fifo_peek_head(&data->rx_fifo);
+		size_t len;
+
+		if (!frag) {
+			break;
+		}
+
+		len = MIN(frag->len, size - *bytes_read);
+		memcpy(buf + *bytes_read, frag->data, len);
+		net_buf_pull(frag, len);
+		*bytes_read += len;
+
+		if (frag->len == 0) {
+			k_fifo_get(&data->rx_fifo, K_NO_WAIT);
+			net_buf_unref(frag);
+		}
+	}
+#else
+	/* Pull data off the ring buffer */
 	*bytes_read = ring_buf_get(&data->rx_rb, buf, size);
+#endif
+	return 0;
+}
+
+#ifdef CONFIG_MGSM_MODEM_IFACE_UART_ASYNC_RX_ZERO_COPY
+static int modem_iface_uart_async_read_buf(struct modem_iface *iface,
+					   struct net_buf **frag)
+{
+	struct modem_iface_uart_data *data;
+
+	if (!iface || !iface->iface_data) {
+		return -EINVAL;
+	}
+
+	data = iface->iface_data;
+	*frag = k_fifo_get(&data->rx_fifo, K_NO_WAIT);
+
+	return *frag ? 0 : -EAGAIN;
+}
+#endif
+
+static void tx_queue_block(struct modem_iface *iface, struct tx_block *block)
+{
+	struct modem_iface_uart_data *data = iface->iface_data;
+	k_spinlock_key_t key;
+	bool idle;
+
+	key = k_spin_lock(&data->tx_lock);
+	idle = sys_slist_is_empty(&data->tx_queue);
+	sys_slist_append(&data->tx_queue, &block->node);
+	if (idle) {
+		tx_start_next(iface->dev, data);
+	}
+	k_spin_unlock(&data->tx_lock, key);
+}
+
+static int modem_iface_uart_async_writev(struct modem_iface *iface,
+					 const struct iovec *iov, size_t iovcnt)
+{
+	struct modem_iface_uart_data *data;
+	struct tx_block *block = NULL;
+	k_spinlock_key_t key;
+	size_t i, off, chunk;
+	int rc;
+
+	if (!iface || !iface->iface_data) {
+		return -EINVAL;
+	}
+
+	data = iface->iface_data;
+
+	/* Report a transmission aborted since the last write */
+	key = k_spin_lock(&data->tx_lock);
+	rc = data->tx_err;
+	data->tx_err = 0;
+	k_spin_unlock(&data->tx_lock, key);
+	if (rc < 0) {
+		return rc;
+	}
+
+	/* Copy into slab blocks, each block is queued once it is full */
+	for (i = 0; i < iovcnt; i++) {
+		for (off = 0; off < iov[i].iov_len; off += chunk) {
+			if (!block) {
+				/* Waits for the UART to free a block */
+				k_mem_slab_alloc(&uart_modem_async_tx_slab,
+						 (void **)&block, K_FOREVER);
+				block->len = 0;
+			}
+
+			chunk = MIN(iov[i].iov_len - off, TX_BUFFER_SIZE - block->len);
+			memcpy(&block->data[block->len],
+			       (const uint8_t *)iov[i].iov_base + off, chunk);
+			block->len += chunk;
+
+			if (block->len == TX_BUFFER_SIZE) {
+				tx_queue_block(iface, block);
+				block = NULL;
+			}
+		}
+	}
+
+	if (block) {
+		tx_queue_block(iface, block);
+	}
+
 	return 0;
 }
 
 static int modem_iface_uart_async_write(struct modem_iface *iface,
 					const uint8_t *buf, size_t size)
+{
+	struct iovec iov = {
+		.iov_base = (void *)buf,
+		.iov_len = size,
+	};
+
+	return modem_iface_uart_async_writev(iface, &iov, 1);
+}
+
+int modem_iface_uart_tx_wait(struct modem_iface *iface, k_timeout_t timeout)
 {
 	struct modem_iface_uart_data *data;
-	int rc;
+	k_spinlock_key_t key;
+	bool busy;
 
 	if (!iface || !iface->iface_data) {
 		return -EINVAL;
 	}
 
-	if (size == 0) {
-		return 0;
+	data = iface->iface_data;
+
+	/* A stale give from an earlier drain only costs one more round */
+	while (true) {
+		key = k_spin_lock(&data->tx_lock);
+		busy = !sys_slist_is_empty(&data->tx_queue);
+		k_spin_unlock(&data->tx_lock, key);
+
+		if (!busy) {
+			break;
+		}
+
+		if (k_sem_take(&data->tx_done_sem, timeout) < 0) {
+			return -EAGAIN;
+		}
 	}
 
-	/* Start the transmission */
-	rc = uart_tx(iface->dev, buf, size, SYS_FOREVER_MS);
-	if (rc >= 0) {
-		/* Wait until the transmission completes */
-		data = iface->iface_data;
-		k_sem_take(&data->tx_sem, K_FOREVER);
+	return 0;
+}
+
+int modem_iface_uart_stats_get(struct modem_iface *iface,
+			       struct modem_iface_uart_stats *stats)
+{
+	if (!iface || !stats || iface->read != modem_iface_uart_async_read ||
+	    !iface->iface_data) {
+		return -EINVAL;
 	}
-	return rc;
+
+	return -ENOTSUP;
 }
 
 int modem_iface_uart_init_dev(struct modem_iface *iface,
 			      const struct device *dev)
 {
-	struct modem_iface_uart_data *data;
-	void *buf;
+	struct rx_block *block;
 	int rc;
 
 	if (!device_is_ready(dev)) {
@@ -131,7 +439,6 @@ int modem_iface_uart_init_dev(struct modem_iface *iface,
 	}
 
 	iface->dev = dev;
-	data = iface->iface_data;
 
 	/* Configure async UART callback */
 	rc = uart_callback_set(dev, iface_uart_async_callback, iface);
@@ -140,10 +447,12 @@ int modem_iface_uart_init_dev(struct modem_iface *iface,
 		return rc;
 	}
 	/* Enable reception permanently on the interface */
-	k_mem_slab_alloc(&uart_modem_async_rx_slab, (void **)&buf, K_FOREVER);
-	rc = uart_rx_enable(dev, buf, RX_BUFFER_SIZE, CONFIG_MODEM_IFACE_UART_ASYNC_RX_TIMEOUT_US);
+	block = rx_block_alloc(K_FOREVER);
+	rc = uart_rx_enable(dev, block->data, RX_BUFFER_SIZE,
+			    CONFIG_MGSM_MODEM_IFACE_UART_ASYNC_RX_TIMEOUT_US);
 	if (rc < 0) {
 		LOG_ERR("Failed to enable UART RX");
+		rx_block_unref(block);
 	}
 	return rc;
 }
@@ -160,10 +469,17 @@ int modem_iface_uart_init(struct modem_iface *iface, struct modem_iface_uart_dat
 	iface->iface_data = data;
 	iface->read = modem_iface_uart_async_read;
 	iface->write = modem_iface_uart_async_write;
+	iface->writev = modem_iface_uart_async_writev;
+#ifdef CONFIG_MGSM_MODEM_IFACE_UART_ASYNC_RX_ZERO_COPY
+	iface->read_buf = modem_iface_uart_async_read_buf;
+	k_fifo_init(&data->rx_fifo);
+#endif
 
 	ring_buf_init(&data->rx_rb, config->rx_rb_buf_len, config->rx_rb_buf);
 	k_sem_init(&data->rx_sem, 0, 1);
-	k_sem_init(&data->tx_sem, 0, 1);
+	k_sem_init(&data->tx_done_sem, 0, 1);
+	sys_slist_init(&data->tx_queue);
+	data->tx_err = 0;
 
 	/* Configure hardware flow control */
 	data->hw_flow_control = config->hw_flow_control;
@@ -174,6 +490,8 @@ int modem_iface_uart_init(struct modem_iface *iface, struct modem_iface_uart_dat
 		iface->iface_data = NULL;
 		iface->read = NULL;
 		iface->write = NULL;
+		iface->writev = NULL;
+		iface->read_buf = NULL;
 
 		return ret;
 	}
@@ -19,6 +19,13 @@ LOG_MODULE_REGISTER(modem_iface_uart, CONFIG_MODEM_LOG_LEVEL);
 #include "modem_context.h"
 #include "modem_iface_uart.h"
 
+#define RX_COALESCE_BYTES CONFIG_MGSM_MODEM_IFACE_UART_RX_COALESCE_BYTES
+#define RX_COALESCE_IDLE K_USEC(CONFIG_MGSM_MODEM_IFACE_UART_RX_COALESCE_IDLE_US)
+
+BUILD_ASSERT(CONFIG_MGSM_MODEM_IFACE_UART_RX_LOW_WATERMARK <
+	     CONFIG_MGSM_MODEM_IFACE_UART_RX_HIGH_WATERMARK,
+	     "RX low watermark must be below the high watermark");
+
 /**
  * @brief  Drains UART.
  *
@@ -37,53 +44,185 @@ static void modem_iface_uart_flush(struct modem_iface *iface)
 	}
 }
 
+/**
+ * @brief  Moves queued data from the TX ring buffer to the UART FIFO.
+ *
+ * @note   Disables the TX interrupt once the ring buffer is empty and the
+ *         UART has shifted out the last byte.
+ *
+ * @param  *dev: uart device.
+ * @param  *data: modem interface data.
+ *
+ * @retval None.
+ */
+static void modem_iface_uart_tx_isr(const struct device *dev,
+				    struct modem_iface_uart_data *data)
+{
+	uint8_t *src;
+	uint32_t len;
+	int sent;
+
+	len = ring_buf_get_claim(&data->tx_rb, &src, UINT32_MAX);
+	if (len == 0) {
+		/* Drivers without the check count as complete */
+		if (uart_irq_tx_complete(dev) != 0) {
+			uart_irq_tx_disable(dev);
+			data->tx_active = false;
+			k_sem_give(&data->tx_done_sem);
+		}
+
+		return;
+	}
+
+	sent = uart_fifo_fill(dev, src, len);
+	ring_buf_get_finish(&data->tx_rb, MAX(sent, 0));
+
+	if (sent > 0) {
+		k_sem_give(&data->tx_space_sem);
+	}
+}
+
+/**
+ * @brief  Stops reading the UART until the reader catches up.
+ *
+ * @note   Called from the ISR, HW flow control then holds off the modem.
+ *
+ * @param  *dev: uart device.
+ * @param  *data: modem interface data.
+ *
+ * @retval None.
+ */
+static void modem_iface_uart_rx_pause(const struct device *dev,
+				      struct modem_iface_uart_data *data)
+{
+	uart_irq_rx_disable(dev);
+
+	if (!data->rx_paused) {
+		data->rx_paused = true;
+		data->rx_pause_count++;
+		data->rx_pause_start = k_uptime_get_32();
+	}
+}
+
+/**
+ * @brief  Wakes the reader for the pending received data.
+ *
+ * @param  *data: modem interface data.
+ * @param  idle: woken by the idle line timer.
+ *
+ * @retval None.
+ */
+static void modem_iface_uart_rx_wake(struct modem_iface_uart_data *data,
+				     bool idle)
+{
+	k_spinlock_key_t key = k_spin_lock(&data->rx_lock);
+	uint32_t delay;
+
+	if (data->rx_pending == 0) {
+		k_spin_unlock(&data->rx_lock, key);
+		return;
+	}
+
+	delay = k_cyc_to_us_floor32(k_cycle_get_32() - data->rx_pending_start);
+	data->rx_wakeups++;
+	data->rx_idle_wakeups += idle ? 1 : 0;
+	data->rx_wake_delay_us_sum += delay;
+	data->rx_wake_delay_us_max = MAX(data->rx_wake_delay_us_max, delay);
+	data->rx_pending = 0;
+
+	k_spin_unlock(&data->rx_lock, key);
+
+	k_sem_give(&data->rx_sem);
+}
+
+static void modem_iface_uart_rx_idle(struct k_timer *timer)
+{
+	struct modem_iface_uart_data *data =
+		CONTAINER_OF(timer, struct modem_iface_uart_data, rx_idle_timer);
+
+	modem_iface_uart_rx_wake(data, true);
+}
+
+/**
+ * @brief  Accounts received data and wakes the reader when due.
+ *
+ * @param  *data: modem interface data.
+ * @param  len: number of bytes received.
+ *
+ * @retval None.
+ */
+static void modem_iface_uart_rx_coalesce(struct modem_iface_uart_data *data,
+					 uint32_t len)
+{
+	k_spinlock_key_t key = k_spin_lock(&data->rx_lock);
+	bool wake;
+
+	if (data->rx_pending == 0) {
+		data->rx_pending_start = k_cycle_get_32();
+	}
+
+	data->rx_pending += len;
+	data->rx_bytes += len;
+
+	/* Never hold back the reader while the sender is paused */
+	wake = data->rx_pending >= RX_COALESCE_BYTES || data->rx_paused;
+
+	k_spin_unlock(&data->rx_lock, key);
+
+	if (wake) {
+		k_timer_stop(&data->rx_idle_timer);
+		modem_iface_uart_rx_wake(data, false);
+	} else {
+		k_timer_start(&data->rx_idle_timer, RX_COALESCE_IDLE, K_NO_WAIT);
+	}
+}
+
 /**
  * @brief  Modem interface interrupt handler.
  *
  * @note   Fills interfaces ring buffer with received data.
  *         When ring buffer is full the data is discarded.
+ *         Feeds the UART with data from the TX ring buffer.
  *
  * @param  *uart_dev: uart device.
+ * @param  *user_data: modem interface.
  *
  * @retval None.
  */
 static void modem_iface_uart_isr(const struct device *uart_dev,
 				 void *user_data)
 {
-	struct modem_context *ctx;
+	struct modem_iface *iface = user_data;
 	struct modem_iface_uart_data *data;
 	int rx = 0, ret;
 	uint8_t *dst;
 	uint32_t partial_size = 0;
 	uint32_t total_size = 0;
 
-	ARG_UNUSED(user_data);
-
-	/* lookup the modem context */
-	ctx = modem_context_from_iface_dev(uart_dev);
-	if (!ctx || !ctx->iface.iface_data) {
+	/* the iface is passed as user data, no lookup needed */
+	if (!iface || !iface->iface_data) {
 		return;
 	}
 
-	data = (struct modem_iface_uart_data *)(ctx->iface.iface_data);
+	data = (struct modem_iface_uart_data *)(iface->iface_data);
 	/* get all of the data off UART as fast as we can */
-	while (uart_irq_update(ctx->iface.dev) &&
-	       uart_irq_rx_ready(ctx->iface.dev)) {
+	while (uart_irq_update(iface->dev) &&
+	       uart_irq_rx_ready(iface->dev)) {
 		if (!partial_size) {
 			partial_size = ring_buf_put_claim(&data->rx_rb, &dst,
 							  UINT32_MAX);
 		}
 		if (!partial_size) {
 			if (data->hw_flow_control) {
-				uart_irq_rx_disable(ctx->iface.dev);
+				modem_iface_uart_rx_pause(iface->dev, data);
 			} else {
 				LOG_ERR("Rx buffer doesn't have enough space");
-				modem_iface_uart_flush(&ctx->iface);
+				modem_iface_uart_flush(iface);
 			}
 			break;
 		}
 
-		rx = uart_fifo_read(ctx->iface.dev, dst, partial_size);
+		rx = uart_fifo_read(iface->dev, dst, partial_size);
 		if (rx <= 0) {
 			continue;
 		}
@@ -96,8 +235,17 @@ static void modem_iface_uart_isr(const struct device *uart_dev,
 	ret = ring_buf_put_finish(&data->rx_rb, total_size);
 	__ASSERT_NO_MSG(ret == 0);
 
+	if (data->hw_flow_control &&
+	    ring_buf_size_get(&data->rx_rb) >= data->rx_high) {
+		modem_iface_uart_rx_pause(iface->dev, data);
+	}
+
 	if (total_size > 0) {
-		k_sem_give(&data->rx_sem);
+		modem_iface_uart_rx_coalesce(data, total_size);
+	}
+
+	if (uart_irq_tx_ready(iface->dev)) {
+		modem_iface_uart_tx_isr(iface->dev, data);
 	}
 }
 
@@ -118,7 +266,11 @@ static int modem_iface_uart_read(struct modem_iface *iface,
 	data = (struct modem_iface_uart_data *)(iface->iface_data);
 	*bytes_read = ring_buf_get(&data->rx_rb, buf, size);
 
-	if (data->hw_flow_control && *bytes_read == 0) {
+	/* RX is disabled while paused, so the ISR does not race with us */
+	if (data->rx_paused &&
+	    ring_buf_size_get(&data->rx_rb) <= data->rx_low) {
+		data->rx_paused = false;
+		data->rx_paused_ms += k_uptime_get_32() - data->rx_pause_start;
 		uart_irq_rx_enable(iface->dev);
 	}
 
@@ -137,6 +289,32 @@ static bool mux_is_active(struct modem_iface *iface)
 	return active;
 }
 
+static bool tx_irq_is_used(struct modem_iface_uart_data *data)
+{
+	return ring_buf_capacity_get(&data->tx_rb) > 0;
+}
+
+static void modem_iface_uart_write_irq(struct modem_iface *iface,
+				       const uint8_t *buf, size_t size)
+{
+	struct modem_iface_uart_data *data = iface->iface_data;
+	uint32_t written;
+
+	/* The ISR sends the data, we only have to wait if it does not fit */
+	while (size > 0) {
+		written = ring_buf_put(&data->tx_rb, buf, size);
+		buf += written;
+		size -= written;
+
+		data->tx_active = true;
+		uart_irq_tx_enable(iface->dev);
+
+		if (size > 0) {
+			k_sem_take(&data->tx_space_sem, K_FOREVER);
+		}
+	}
+}
+
 static int modem_iface_uart_write(struct modem_iface *iface,
 				  const uint8_t *buf, size_t size)
 {
@@ -155,6 +333,8 @@ static int modem_iface_uart_write(struct modem_iface *iface,
 	 */
 	if (mux_is_active(iface)) {
 		uart_fifo_fill(iface->dev, buf, size);
+	} else if (tx_irq_is_used(iface->iface_data)) {
+		modem_iface_uart_write_irq(iface, buf, size);
 	} else {
 		do {
 			uart_poll_out(iface->dev, *buf++);
@@ -164,6 +344,104 @@ static int modem_iface_uart_write(struct modem_iface *iface,
 	return 0;
 }
 
+/* Mux frames are built per write, so small buffers are merged first */
+#define MUX_GATHER_SIZE 128
+
+static int modem_iface_uart_writev(struct modem_iface *iface,
+				   const struct iovec *iov, size_t iovcnt)
+{
+	uint8_t gather[MUX_GATHER_SIZE];
+	size_t i, total = 0;
+	int ret;
+
+	if (!iface || !iface->iface_data) {
+		return -EINVAL;
+	}
+
+	for (i = 0; i < iovcnt; i++) {
+		total += iov[i].iov_len;
+	}
+
+	if (mux_is_active(iface) && total <= sizeof(gather)) {
+		total = 0;
+
+		for (i = 0; i < iovcnt; i++) {
+			memcpy(&gather[total], iov[i].iov_base, iov[i].iov_len);
+			total += iov[i].iov_len;
+		}
+
+		return modem_iface_uart_write(iface, gather, total);
+	}
+
+	/* The TX ring buffer and polled output do not care about splits */
+	for (i = 0; i < iovcnt; i++) {
+		ret = modem_iface_uart_write(iface, iov[i].iov_base,
+					     iov[i].iov_len);
+		if (ret < 0) {
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+int modem_iface_uart_tx_wait(struct modem_iface *iface, k_timeout_t timeout)
+{
+	struct modem_iface_uart_data *data;
+
+	if (!iface || !iface->iface_data) {
+		return -EINVAL;
+	}
+
+	data = (struct modem_iface_uart_data *)(iface->iface_data);
+
+	/* The TX interrupt tells when the last byte has left the UART, also
+	 * for poll mode writes that did not need it to send the data.
+	 */
+	data->tx_active = true;
+	uart_irq_tx_enable(iface->dev);
+
+	/* A stale give from an earlier drain only costs one more round */
+	while (data->tx_active) {
+		if (k_sem_take(&data->tx_done_sem, timeout) < 0) {
+			return -EAGAIN;
+		}
+	}
+
+	return 0;
+}
+
+int modem_iface_uart_stats_get(struct modem_iface *iface,
+			       struct modem_iface_uart_stats *stats)
+{
+	struct modem_iface_uart_data *data;
+	k_spinlock_key_t key;
+
+	if (!iface || !stats || iface->read != modem_iface_uart_read ||
+	    !iface->iface_data) {
+		return -EINVAL;
+	}
+
+	data = (struct modem_iface_uart_data *)(iface->iface_data);
+
+	/* Masks the ISR, so the pause state does not change while we copy */
+	key = k_spin_lock(&data->rx_lock);
+	stats->rx_pause_count = data->rx_pause_count;
+	stats->rx_paused_ms = data->rx_paused_ms;
+	if (data->rx_paused) {
+		stats->rx_paused_ms += k_uptime_get_32() - data->rx_pause_start;
+	}
+	stats->rx_bytes = data->rx_bytes;
+	stats->rx_wakeups = data->rx_wakeups;
+	stats->rx_idle_wakeups = data->rx_idle_wakeups;
+	stats->rx_wake_delay_us_avg = data->rx_wakeups ?
+		(uint32_t)(data->rx_wake_delay_us_sum / data->rx_wakeups) : 0;
+	stats->rx_wake_delay_us_max = data->rx_wake_delay_us_max;
+	k_spin_unlock(&data->rx_lock, key);
+
+	return 0;
+}
+
 int modem_iface_uart_init_dev(struct modem_iface *iface,
 			      const struct device *dev)
 {
@@ -188,7 +466,7 @@ int modem_iface_uart_init_dev(struct modem_iface *iface,
 	iface->dev = dev;
 
 	modem_iface_uart_flush(iface);
-	uart_irq_callback_set(iface->dev, modem_iface_uart_isr);
+	uart_irq_callback_user_data_set(iface->dev, modem_iface_uart_isr, iface);
 	uart_irq_rx_enable(iface->dev);
 
 	if (prev) {
@@ -210,12 +488,40 @@ int modem_iface_uart_init(struct modem_iface *iface, struct modem_iface_uart_dat
 	iface->iface_data = data;
 	iface->read = modem_iface_uart_read;
 	iface->write = modem_iface_uart_write;
+	iface->writev = modem_iface_uart_writev;
 
 	ring_buf_init(&data->rx_rb, config->rx_rb_buf_len, config->rx_rb_buf);
 	k_sem_init(&data->rx_sem, 0, 1);
 
+	/* Without a TX buffer, uart_poll_out() is used */
+	ring_buf_init(&data->tx_rb, config->tx_rb_buf ? config->tx_rb_buf_len : 0,
+		      config->tx_rb_buf);
+	k_sem_init(&data->tx_space_sem, 0, 1);
+	k_sem_init(&data->tx_done_sem, 0, 1);
+	data->tx_active = false;
+
 	/* Configure hardware flow control */
 	data->hw_flow_control = config->hw_flow_control;
+	data->rx_high = config->rx_rb_buf_len *
+			CONFIG_MGSM_MODEM_IFACE_UART_RX_HIGH_WATERMARK / 100;
+	data->rx_low = config->rx_rb_buf_len *
+		       CONFIG_MGSM_MODEM_IFACE_UART_RX_LOW_WATERMARK / 100;
+
+	/* Rounding may merge the watermarks of a small ring buffer */
+	if (data->rx_low >= data->rx_high) {
+		data->rx_low = data->rx_high > 0 ? data->rx_high - 1 : 0;
+	}
+	data->rx_paused = false;
+	data->rx_pause_count = 0;
+	data->rx_paused_ms = 0;
+
+	k_timer_init(&data->rx_idle_timer, modem_iface_uart_rx_idle, NULL);
+	data->rx_pending = 0;
+	data->rx_bytes = 0;
+	data->rx_wakeups = 0;
+	data->rx_idle_wakeups = 0;
+	data->rx_wake_delay_us_sum = 0;
+	data->rx_wake_delay_us_max = 0;
 
 	/* Get UART device */
 	ret = modem_iface_uart_init_dev(iface, config->dev);
@@ -223,6 +529,7 @@ int modem_iface_uart_init(struct modem_iface *iface, struct modem_iface_uart_dat
 		iface->iface_data = NULL;
 		iface->read = NULL;
 		iface->write = NULL;
+		iface->writev = NULL;
 
 		return ret;
 	}
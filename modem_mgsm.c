@@ -25,6 +25,17 @@ LOG_MODULE_REGISTER(modem_mgsm, CONFIG_MODEM_LOG_LEVEL);
 #include "modem_iface_uart.h"
 #include "modem_cmd_handler.h"
 #include "gsm_mux.h"
+#if defined(CONFIG_MODEM_MGSM_SOCKET_OFFLOAD)
+#include <zephyr/net/socket_offload.h>
+#include <zephyr/net/offloaded_netdev.h>
+#include "modem_socket.h"
+#endif
+#if defined(CONFIG_MODEM_MGSM_SOCKET_TLS)
+#include <zephyr/net/tls_credentials.h>
+#endif
+#if defined(CONFIG_MODEM_MGSM_SIM)
+#include "modem_iface_sim.h"
+#endif
 
 #include <stdio.h>
 
@@ -41,7 +52,24 @@ LOG_MODULE_REGISTER(modem_mgsm, CONFIG_MODEM_LOG_LEVEL);
 #define MGSM_ATTACH_RETRY_DELAY_MSEC     1000
 #define MGSM_REGISTER_DELAY_MSEC         1000
 #define MGSM_RETRY_DELAY                 K_SECONDS(1)
-
+#define MGSM_PDP_ACT_TIMEOUT             K_SECONDS(150)
+#define MGSM_SOCKET_MAX_DATA_LEN         1460
+#define MGSM_SOCKET_OPEN_TIMEOUT         K_SECONDS(150)
+#define MGSM_SOCKET_CLOSE_TIMEOUT        K_SECONDS(10)
+#define MGSM_SOCKET_PROMPT_TIMEOUT       K_SECONDS(5)
+#define MGSM_SOCKET_SEND_TIMEOUT         K_SECONDS(10)
+#define MGSM_SOCKET_WINDOW_POLL_DELAY    K_MSEC(500)
+#define MGSM_SOCKET_IOV_BATCH            4
+#define MGSM_TLS_CTX_MAX                 6
+#define MGSM_TLS_TAG_NONE                -1
+#define MGSM_TLS_UPLOAD_TIMEOUT          K_SECONDS(10)
+#define MGSM_TLS_HOST_LEN                128
+#define MGSM_DNS_TIMEOUT                 K_SECONDS(60)
+#define MGSM_DNS_HOST_LEN                128
+
+#define MGSM_BAUD_SETTLE_MSEC            100
+#define MGSM_BAUD_CHECK_TIMEOUT          K_MSEC(500)
+#define MGSM_BAUD_CHECK_TRIES            3
 #define MGSM_RSSI_RETRY_DELAY_MSEC       2000
 #define MGSM_RSSI_RETRIES                10
 #define MGSM_RSSI_INVALID                -1000
@@ -80,6 +108,63 @@ enum network_state {
 	MGSM_NET_ROAMING,
 };
 
+#if defined(CONFIG_MODEM_MGSM_SOCKET_OFFLOAD)
+struct mgsm_socket_data {
+	struct modem_socket *sock;
+
+	/* +QIOPEN result */
+	struct k_sem sem_open;
+	int open_err;
+	/* connect id in use on the modem, until AT+QICLOSE */
+	bool opened;
+
+	/* polls the acknowledged data while the send window is closed */
+	struct k_work_delayable window_work;
+#if defined(CONFIG_MGSM_MODEM_SOCKET_RX_CACHE)
+	struct k_work fill_work;
+	/* failed fill, returned by the next recv() */
+	int fill_err;
+#endif
+#if defined(CONFIG_MODEM_MGSM_SOCKET_TLS)
+	/* TLS_SEC_TAG_LIST, TLS_PEER_VERIFY and TLS_HOSTNAME options */
+	sec_tag_t sec_tag;
+	int peer_verify;
+	char hostname[MGSM_TLS_HOST_LEN];
+#endif
+};
+
+/* Destination of the AT+QIRD data, used by the RX thread */
+struct mgsm_sock_read {
+	struct modem_socket *sock;
+	const struct iovec *iov;
+	int iovcnt;
+	size_t req;
+	int recv;
+	/* datagram larger than iov, the rest was dropped */
+	bool trunc;
+};
+
+#if defined(CONFIG_MODEM_MGSM_DNS_OFFLOAD)
+struct mgsm_dns_entry {
+	/* empty for a free entry */
+	char host[MGSM_DNS_HOST_LEN];
+	/* AF_UNSPEC for a failed lookup */
+	struct sockaddr addr;
+	/* uptime in ms */
+	int64_t expires;
+};
+#endif
+
+#if defined(CONFIG_MODEM_MGSM_SOCKET_TLS)
+/* Credentials of a security tag stored in the modem file system */
+struct mgsm_tls_tag {
+	sec_tag_t tag;
+	/* BIT(enum tls_credential_type) of the uploaded credentials */
+	uint8_t types;
+};
+#endif
+#endif
+
 static struct mgsm_modem {
 	struct k_mutex lock;
 	const struct device *dev;
@@ -93,6 +178,13 @@ static struct mgsm_modem {
 	struct modem_iface_uart_data mgsm_data;
 	struct k_work_delayable mgsm_configure_work;
 	char mgsm_rx_rb_buf[PPP_MRU * 3];
+#if CONFIG_MODEM_MGSM_TX_BUFFER_SIZE > 0
+	char mgsm_tx_rb_buf[CONFIG_MODEM_MGSM_TX_BUFFER_SIZE];
+#endif
+#if defined(CONFIG_MODEM_MGSM_SIM)
+	struct modem_iface_sim_data sim_data;
+	char sim_tx_rb_buf[MGSM_CMD_READ_BUF * 2];
+#endif
 
 	uint8_t *ppp_recv_buf;
 	size_t ppp_recv_buf_len;
@@ -131,11 +223,49 @@ static struct mgsm_modem {
 	int retries;
 	bool modem_info_queried : 1;
 
+#if defined(CONFIG_MODEM_MGSM_BAUD_ESCALATION)
+	/* UART rate the modem uses after power up */
+	uint32_t boot_baudrate;
+#endif
+
 	void *user_data;
 
 	mgsm_modem_power_cb modem_on_cb;
 	mgsm_modem_power_cb modem_off_cb;
 	struct net_mgmt_event_callback mgsm_mgmt_cb;
+
+#if defined(CONFIG_MODEM_MGSM_SOCKET_OFFLOAD)
+	struct modem_socket_config socket_config;
+	struct modem_socket sockets[CONFIG_MODEM_MGSM_SOCKET_MAX_NUM];
+	struct mgsm_socket_data sock_data[CONFIG_MODEM_MGSM_SOCKET_MAX_NUM];
+	/* AT+QISEND prompt */
+	struct k_sem sem_tx_ready;
+	struct mgsm_sock_read sock_read;
+	/* result of the AT+QIRD and AT+QISEND queries, and the socket asked */
+	int sock_query;
+	struct modem_socket *sock_query_sock;
+#if defined(CONFIG_MGSM_MODEM_SOCKET_RX_CACHE)
+	uint8_t sock_fill_buf[CONFIG_MGSM_MODEM_SOCKET_RX_CACHE_SIZE];
+#endif
+#if defined(CONFIG_MODEM_MGSM_SOCKET_TLS)
+	/* tag cache and upload buffer, shared by the connecting sockets */
+	struct k_mutex tls_lock;
+	struct mgsm_tls_tag tls_tags[CONFIG_MODEM_MGSM_SOCKET_TLS_MAX_TAGS];
+	size_t tls_tags_len;
+	size_t tls_tags_next;
+	uint8_t tls_cred_buf[CONFIG_MODEM_MGSM_SOCKET_TLS_CRED_MAX];
+#endif
+#if defined(CONFIG_MODEM_MGSM_DNS_OFFLOAD)
+	/* one AT+QIDNSGIP at a time, the URCs do not name the host */
+	struct k_mutex dns_lock;
+	struct k_sem sem_dns;
+	int dns_err;
+	int dns_left;
+	uint32_t dns_ttl;
+	struct sockaddr dns_addr;
+	struct mgsm_dns_entry dns_cache[CONFIG_MODEM_MGSM_DNS_CACHE_SIZE];
+#endif
+#endif
 } mgsm;
 
 NET_BUF_POOL_DEFINE(mgsm_recv_pool, MGSM_RECV_MAX_BUF, MGSM_RECV_BUF_SIZE, 0, NULL);
@@ -188,12 +318,66 @@ static int modem_atoi(const char *s, const int err_value,
 }
 #endif
 
+#if defined(CONFIG_MODEM_MGSM_SIM)
+/* BG95 like replies to the commands of the configuration sequence */
+static const struct modem_iface_sim_rule mgsm_sim_rules[] = {
+	{ "AT+CGMI", "\r\nQuectel\r\n\r\nOK\r\n" },
+	{ "AT+CGMM", "\r\nBG95-M3\r\n\r\nOK\r\n" },
+	{ "AT+CGMR", "\r\nBG95M3LAR02A03\r\n\r\nOK\r\n" },
+	{ "AT+CIMI", "\r\n001010123456789\r\n\r\nOK\r\n" },
+	{ "AT+CSQ", "\r\n+CSQ: 20,99\r\n\r\nOK\r\n" },
+	{ "AT+CESQ", "\r\n+CESQ: 99,99,255,255,20,50\r\n\r\nOK\r\n" },
+	{ "AT+CEREG?", "\r\n+CEREG: 0,1\r\n\r\nOK\r\n" },
+	{ "AT+COPS?", "\r\n+COPS: 0,2,\"00101\",8\r\n\r\nOK\r\n" },
+	{ "AT+CGATT?", "\r\n+CGATT: 1\r\n\r\nOK\r\n" },
+	{ "AT+CGATT=1", "\r\nOK\r\n", 500 },
+	{ "AT+CGPADDR", "\r\n+CGPADDR: 1,\"10.0.0.2\"\r\n\r\nOK\r\n" },
+	{ "AT+CMUX", "\r\nOK\r\n", 0, true },
+	{ "ATD", "\r\nCONNECT 150000000\r\n", 100 },
+#if defined(CONFIG_MODEM_MGSM_SOCKET_OFFLOAD)
+	/* A single socket, id 0, with an echo like peer */
+	{ "AT+QIACT=1", "\r\nOK\r\n", 200 },
+	{ "AT+QIOPEN=", "\r\nOK\r\n\r\n+QIOPEN: 0,0\r\n", 100 },
+	{ "AT+QISEND=0,0", "\r\n+QISEND: 100,100,0\r\n\r\nOK\r\n" },
+	{ "AT+QISEND=", "\r\n> ", 0, false, "\r\nSEND OK\r\n" },
+	{ "AT+QIRD=0,0", "\r\n+QIRD: 5,0,5\r\n\r\nOK\r\n" },
+	{ "AT+QIRD=", "\r\n+QIRD: 5\r\nhello\r\n\r\nOK\r\n" },
+#endif
+#if defined(CONFIG_MODEM_MGSM_DNS_OFFLOAD)
+	{ "AT+QIDNSGIP=", "\r\nOK\r\n\r\n+QIURC: \"dnsgip\",0,1,600\r\n"
+			  "\r\n+QIURC: \"dnsgip\",\"10.0.0.1\"\r\n", 300 },
+#endif
+#if defined(CONFIG_MODEM_MGSM_SOCKET_TLS)
+	{ "AT+QFUPL=", "\r\nCONNECT\r\n", 0, false, "\r\n+QFUPL: 0,0\r\n\r\nOK\r\n" },
+	/* The delay stands for the handshake done by the modem */
+	{ "AT+QSSLOPEN=", "\r\nOK\r\n\r\n+QSSLOPEN: 0,0\r\n", 1500 },
+	{ "AT+QSSLSEND=", "\r\n> ", 0, false, "\r\nSEND OK\r\n" },
+	{ "AT+QSSLRECV=", "\r\n+QSSLRECV: 5\r\nhello\r\n\r\nOK\r\n" },
+#endif
+	/* Anything else is accepted */
+	{ "AT", "\r\nOK\r\n" },
+};
+
+#if defined(CONFIG_MODEM_MGSM_SOCKET_OFFLOAD)
+static const struct modem_iface_sim_urc mgsm_sim_urcs[] = {
+	{ "\r\n+QIURC: \"recv\",0\r\n", 1000 },
+#if defined(CONFIG_MODEM_MGSM_SOCKET_TLS)
+	{ "\r\n+QSSLURC: \"recv\",0\r\n", 1000 },
+#endif
+};
+#endif
+#endif
+
 static void mgsm_rx(struct mgsm_modem *mgsm)
 {
 	LOG_DBG("starting");
 
 	while (true) {
+#if defined(CONFIG_MODEM_MGSM_SIM)
+		modem_iface_sim_rx_wait(&mgsm->context.iface, K_FOREVER);
+#else
 		modem_iface_uart_rx_wait(&mgsm->context.iface, K_FOREVER);
+#endif
 
 		/* The handler will listen AT channel */
 		modem_cmd_handler_process(&mgsm->context.cmd_handler, &mgsm->context.iface);
@@ -225,11 +409,26 @@ MODEM_CMD_DEFINE(mgsm_cmd_exterror)
 	return 0;
 }
 
+#if defined(CONFIG_MODEM_MGSM_SOCKET_OFFLOAD)
+/* Handler: SEND FAIL, the modem send buffer is full */
+MODEM_CMD_DEFINE(on_cmd_send_fail)
+{
+	(void)modem_cmd_handler_set_error(data, -EAGAIN);
+	k_sem_give(&mgsm.sem_response);
+	return 0;
+}
+
+#endif
+
 static const struct modem_cmd response_cmds[] = {
 	MODEM_CMD("OK", mgsm_cmd_ok, 0U, ""),
 	MODEM_CMD("ERROR", mgsm_cmd_error, 0U, ""),
 	MODEM_CMD("+CME ERROR: ", mgsm_cmd_exterror, 1U, ""),
 	MODEM_CMD("CONNECT", mgsm_cmd_ok, 0U, ""),
+#if defined(CONFIG_MODEM_MGSM_SOCKET_OFFLOAD)
+	MODEM_CMD("SEND OK", mgsm_cmd_ok, 0U, ""),
+	MODEM_CMD("SEND FAIL", on_cmd_send_fail, 0U, ""),
+#endif
 };
 
 static int unquoted_atoi(const char *s, int base)
@@ -248,7 +447,7 @@ MODEM_CMD_DEFINE(on_cmd_atcmdinfo_cops)
 {
 	if (argc >= 1) {
 		LOG_INF("!!! inside argc of cops");
-#if defined(CONFIG_MODEM_CELL_INFO)
+#if defined(CONFIG_MGSM_MODEM_CELL_INFO)
 		if (argc >= 3) {
 			mgsm.context.data_operator = unquoted_atoi(argv[2], 10);
 			LOG_INF("operator: %u",
@@ -327,7 +526,7 @@ MODEM_CMD_DEFINE(on_cmd_atcmdinfo_imei)
 	return 0;
 }
 
-#if defined(CONFIG_MODEM_SIM_NUMBERS)
+#if defined(CONFIG_MGSM_MODEM_SIM_NUMBERS)
 /* Handler: <IMSI> */
 MODEM_CMD_DEFINE(on_cmd_atcmdinfo_imsi)
 {
@@ -365,7 +564,7 @@ MODEM_CMD_DEFINE(on_cmd_atcmdinfo_imsi)
 
 // 	return 0;
 // }
-#endif /* CONFIG_MODEM_SIM_NUMBERS */
+#endif /* CONFIG_MGSM_MODEM_SIM_NUMBERS */
 
 /* Handler: <CGPADDR> */
 MODEM_CMD_DEFINE(on_cmd_ipinfo)
@@ -406,7 +605,7 @@ MODEM_CMD_DEFINE(on_cmd_net_reg_sts)
 	return 0;
 }
 
-#if defined(CONFIG_MODEM_CELL_INFO)
+#if defined(CONFIG_MGSM_MODEM_CELL_INFO)
 
 /*
  * Handler: +CEREG: <n>[0],<stat>[1],<tac>[2],<ci>[3],<AcT>[4]
@@ -454,7 +653,7 @@ static int mgsm_query_cellinfo(struct mgsm_modem *mgsm)
 
 	return ret;
 }
-#endif /* CONFIG_MODEM_CELL_INFO */
+#endif /* CONFIG_MGSM_MODEM_CELL_INFO */
 
 #if defined(CONFIG_MODEM_MGSM_ENABLE_CESQ_RSSI)
 /*
@@ -522,7 +721,7 @@ static const struct setup_cmd setup_modem_info_cmds[] = {
 	SETUP_CMD("AT+CGMM", "", on_cmd_atcmdinfo_model, 0U, ""),
 	SETUP_CMD("AT+CGMR", "", on_cmd_atcmdinfo_revision, 0U, ""),
 	// SETUP_CMD("AT+CGSN", "", on_cmd_atcmdinfo_imei, 0U, ""),
-#if defined(CONFIG_MODEM_SIM_NUMBERS)
+#if defined(CONFIG_MGSM_MODEM_SIM_NUMBERS)
 	SETUP_CMD("AT+CIMI", "", on_cmd_atcmdinfo_imsi, 0U, ""),
 	// SETUP_CMD("AT+CCID", "", on_cmd_atcmdinfo_iccid, 0U, ""),
 #endif
@@ -578,128 +777,1743 @@ static const struct setup_cmd setup_cmds[] = {
 // 	// SETUP_CMD_NOHANDLE("AT+CGATT=1"),
 // };
 
-MODEM_CMD_DEFINE(on_cmd_atcmdinfo_attached)
+MODEM_CMD_DEFINE(on_cmd_atcmdinfo_attached)
+{
+	/* Expected response is "+CGATT: 0|1" so simply look for '1' */
+	if ((argc > 0) && (atoi(argv[0]) == 1)) {
+		LOG_INF("Attached to packet service!");
+	}
+
+	return 0;
+}
+
+
+static const struct modem_cmd read_cops_cmd =
+	MODEM_CMD_ARGS_MAX("+COPS:", on_cmd_atcmdinfo_cops, 1U, 4U, ",");
+
+static const struct modem_cmd check_net_reg_cmd =
+	MODEM_CMD("+CEREG: ", on_cmd_net_reg_sts, 2U, ",");
+
+static const struct modem_cmd check_attached_cmd =
+	MODEM_CMD("+CGATT:", on_cmd_atcmdinfo_attached, 1U, ",");
+
+static const struct modem_cmd check_ip_cmd = 
+	MODEM_CMD("+CGPADDR:", on_cmd_ipinfo, 2U, "," );
+
+#if !defined(CONFIG_MODEM_MGSM_SOCKET_OFFLOAD)
+static const struct setup_cmd connect_cmds[] = {
+	/* connect to network */
+	SETUP_CMD_NOHANDLE("AT+CGPADDR"),
+	SETUP_CMD_NOHANDLE("ATD*99#"),
+};
+#endif
+
+static int mgsm_query_modem_info(struct mgsm_modem *mgsm)
+{
+	LOG_INF("!!! mgsm QUERY INFO");
+	int ret;
+
+	if (mgsm->modem_info_queried) {
+		return 0;
+	}
+
+	ret = modem_cmd_handler_setup_cmds_nolock(&mgsm->context.iface,
+						  &mgsm->context.cmd_handler,
+						  setup_modem_info_cmds,
+						  ARRAY_SIZE(setup_modem_info_cmds),
+						  &mgsm->sem_response,
+						  MGSM_CMD_SETUP_TIMEOUT);
+	LOG_DBG("RETURN VALUE OF CMD_SETUP_NOLOCK: %d", ret);
+
+	if (ret < 0) {
+		return ret;
+	}
+
+	mgsm->modem_info_queried = true;
+
+	return 0;
+}
+
+static int mgsm_setup_mccmno(struct mgsm_modem *mgsm)
+{
+	int ret = 0;
+	LOG_INF("inside mgsm_setup_mcmno");
+	ret = modem_cmd_send_nolock(&mgsm->context.iface,
+						    &mgsm->context.cmd_handler,
+						    NULL, 0, "AT+CFUN=1",
+						    &mgsm->sem_response,
+						    MGSM_CMD_AT_TIMEOUT);
+	if (ret < 0) {
+		LOG_ERR("AT+CFUN ret:%d", ret);
+	}
+
+	// ret = modem_cmd_send_nolock(&mgsm->context.iface,
+	// 					    &mgsm->context.cmd_handler,
+	// 					    NULL, 0, "AT+CFUN=1",
+	// 					    &mgsm->sem_response,
+	// 					    MGSM_CMD_AT_TIMEOUT);
+	// if (ret < 0) {
+	// 	LOG_ERR("AT+CFUN ret:%d", ret);
+	// }
+
+	if (CONFIG_MODEM_MGSM_MANUAL_MCCMNO[0] != '\0') {
+		LOG_INF("sends AT+COPS=1,2,2404");
+		/* use manual MCC/MNO entry */
+		ret = modem_cmd_send_nolock(&mgsm->context.iface,
+					    &mgsm->context.cmd_handler,
+					    NULL, 0,
+					    "AT+COPS=1,2,\""
+					    CONFIG_MODEM_MGSM_MANUAL_MCCMNO
+					    "\"",
+					    &mgsm->sem_response,
+					    MGSM_CMD_AT_TIMEOUT);
+	} else {
+
+/* First AT+COPS? is sent to check if automatic selection for operator
+ * is already enabled, if yes we do not send the command AT+COPS= 0,0.
+ */
+		LOG_INF("sends AT+COPS?");
+		ret = modem_cmd_send_nolock(&mgsm->context.iface,
+					    &mgsm->context.cmd_handler,
+					    &read_cops_cmd,
+					    1, "AT+COPS?",
+					    &mgsm->sem_response,
+					    MGSM_CMD_SETUP_TIMEOUT);
+
+		if (ret < 0) {
+			return ret;
+		}
+
+		if (!mgsm->context.is_automatic_oper) {
+			/* register operator automatically */
+			ret = modem_cmd_send_nolock(&mgsm->context.iface,
+						    &mgsm->context.cmd_handler,
+						    NULL, 0, "AT+COPS=0,0",
+						    &mgsm->sem_response,
+						    MGSM_CMD_AT_TIMEOUT);
+		}
+	}
+
+	if (ret < 0) {
+		LOG_ERR("AT+COPS ret:%d", ret);
+	}
+
+	return ret;
+}
+
+#if defined(CONFIG_MODEM_MGSM_SOCKET_OFFLOAD)
+/*
+ * Socket offload
+ *
+ * TCP and UDP sockets run on the BG95 TCP/IP stack in buffer access mode:
+ * received data stays in the modem until read with AT+QIRD, announced by
+ * a +QIURC: "recv" URC which does not carry the length.
+ */
+
+static const struct socket_op_vtable offload_socket_fd_op_vtable;
+
+/* TLS sockets use the AT+QSSL commands and the SSL context of their connect id */
+static bool mgsm_sock_tls(const struct modem_socket *sock)
+{
+	return IS_ENABLED(CONFIG_MODEM_MGSM_SOCKET_TLS) && sock->ip_proto == IPPROTO_TLS_1_2;
+}
+
+static bool mgsm_sock_cached(struct modem_socket *sock)
+{
+	/* Filling needs the unread length, which AT+QSSLRECV cannot report */
+	return IS_ENABLED(CONFIG_MGSM_MODEM_SOCKET_RX_CACHE) && sock->type == SOCK_STREAM &&
+	       !mgsm_sock_tls(sock);
+}
+
+/* The socket is gone on the modem side, wake up its readers and writers */
+static void mgsm_sock_closed(struct modem_socket *sock)
+{
+	sock->is_connected = false;
+	modem_socket_data_ready(&mgsm.socket_config, sock);
+	modem_socket_send_window_update(&mgsm.socket_config, sock,
+					MODEM_SOCKET_SEND_WINDOW_NONE);
+}
+
+/* Handler: +QIOPEN: or +QSSLOPEN: <connect_id>[0],<err>[1] */
+MODEM_CMD_DEFINE(on_cmd_sock_open)
+{
+	struct modem_socket *sock;
+	struct mgsm_socket_data *sd;
+
+	sock = modem_socket_from_id(&mgsm.socket_config, atoi(argv[0]));
+	if (!sock) {
+		return 0;
+	}
+
+	sd = sock->data;
+	sd->open_err = atoi(argv[1]);
+	k_sem_give(&sd->sem_open);
+
+	return 0;
+}
+
+#if defined(CONFIG_MODEM_MGSM_DNS_OFFLOAD)
+/*
+ * Handler part: +QIURC: "dnsgip",<err>,<IP_count>,<DNS_ttl>
+ * followed by +QIURC: "dnsgip","<IP_addr>" for each address
+ */
+static void mgsm_dns_urc(uint8_t **argv, uint16_t argc)
+{
+	char *ip;
+	size_t len;
+
+	if (argc >= 4) {
+		mgsm.dns_err = atoi(argv[1]);
+		mgsm.dns_left = atoi(argv[2]);
+		mgsm.dns_ttl = atoi(argv[3]);
+		mgsm.dns_addr.sa_family = AF_UNSPEC;
+
+		if (mgsm.dns_err != 0 || mgsm.dns_left <= 0) {
+			k_sem_give(&mgsm.sem_dns);
+		}
+
+		return;
+	}
+
+	if (argc < 2 || mgsm.dns_left <= 0) {
+		return;
+	}
+
+	ip = argv[1];
+	if (*ip == '"') {
+		ip++;
+	}
+
+	len = strlen(ip);
+	if (len > 0 && ip[len - 1] == '"') {
+		ip[len - 1] = '\0';
+	}
+
+	/* The first address is used */
+	if (mgsm.dns_addr.sa_family == AF_UNSPEC) {
+		if (net_addr_pton(AF_INET, ip, &net_sin(&mgsm.dns_addr)->sin_addr) == 0) {
+			mgsm.dns_addr.sa_family = AF_INET;
+		} else if (net_addr_pton(AF_INET6, ip,
+					 &net_sin6(&mgsm.dns_addr)->sin6_addr) == 0) {
+			mgsm.dns_addr.sa_family = AF_INET6;
+		}
+	}
+
+	if (--mgsm.dns_left == 0) {
+		k_sem_give(&mgsm.sem_dns);
+	}
+}
+#endif
+
+/*
+ * Handler: +QIURC: or +QSSLURC: "recv"|"closed",<connect_id>
+ * or +QIURC: "pdpdeact",<context_id> or "dnsgip",...
+ */
+MODEM_CMD_DEFINE(on_cmd_sock_urc)
+{
+	struct modem_socket *sock;
+	size_t i;
+
+#if defined(CONFIG_MODEM_MGSM_DNS_OFFLOAD)
+	if (strcmp(argv[0], "\"dnsgip\"") == 0) {
+		mgsm_dns_urc(argv, argc);
+		return 0;
+	}
+#endif
+
+	if (strcmp(argv[0], "\"pdpdeact\"") == 0) {
+		LOG_WRN("PDP context deactivated");
+		for (i = 0; i < ARRAY_SIZE(mgsm.sockets); i++) {
+			if (modem_socket_is_allocated(&mgsm.socket_config, &mgsm.sockets[i])) {
+				mgsm_sock_closed(&mgsm.sockets[i]);
+			}
+		}
+
+		return 0;
+	}
+
+	sock = modem_socket_from_id(&mgsm.socket_config, atoi(argv[1]));
+	if (!sock) {
+		return 0;
+	}
+
+	if (strcmp(argv[0], "\"closed\"") == 0) {
+		LOG_DBG("socket %d closed by peer", sock->id);
+		mgsm_sock_closed(sock);
+	} else if (strcmp(argv[0], "\"recv\"") == 0) {
+		/* The length is not reported, one byte marks data as pending */
+		if (modem_socket_next_packet_size(&mgsm.socket_config, sock) == 0U) {
+			(void)modem_socket_packet_size_update(&mgsm.socket_config, sock, 1);
+		}
+
+#if defined(CONFIG_MGSM_MODEM_SOCKET_RX_CACHE)
+		if (mgsm_sock_cached(sock)) {
+			struct mgsm_socket_data *sd = sock->data;
+
+			/* Reading needs the RX thread, so it is done from the workqueue */
+			(void)k_work_submit_to_queue(&mgsm.workq, &sd->fill_work);
+			return 0;
+		}
+#endif
+		modem_socket_data_ready(&mgsm.socket_config, sock);
+	}
+
+	return 0;
+}
+
+/*
+ * The modem only sends a new "recv" URC once its buffer has been read
+ * empty. A read that comes back short has emptied it, so the pending
+ * marker is cleared here on the RX thread, in order with the URCs, and
+ * a URC that follows the response always sets it again.
+ */
+static void mgsm_sock_read_done(struct mgsm_sock_read *rd, int data_len)
+{
+	/* One datagram per read, only an empty read tells that none are left */
+	if (data_len <= 0 ||
+	    (rd->sock->type == SOCK_STREAM && (size_t)data_len < rd->req)) {
+		(void)modem_socket_packet_size_update(&mgsm.socket_config, rd->sock, 0);
+	}
+}
+
+/* Handler: +QIRD: or +QSSLRECV: <read_len>[0]\r\n<data> */
+MODEM_CMD_DEFINE(on_cmd_sock_readdata)
+{
+	struct mgsm_sock_read *rd = &mgsm.sock_read;
+	int data_len = atoi(argv[0]);
+	/* rest of the line and CR LF */
+	size_t skip = len + 2;
+	size_t offset = 0;
+	int i;
+
+	if (data_len <= 0) {
+		rd->recv = 0;
+		mgsm_sock_read_done(rd, data_len);
+		return 0;
+	}
+
+	if (!data->rx_buf) {
+		return -EINVAL;
+	}
+
+	if (net_buf_frags_len(data->rx_buf) < skip + data_len) {
+		/* wait for the rest of the data */
+		return -EAGAIN;
+	}
+
+	data->rx_buf = net_buf_skip(data->rx_buf, skip);
+
+	/* Scattered straight from the fragments, data not fitting is dropped */
+	for (i = 0; i < rd->iovcnt && offset < data_len; i++) {
+		offset += net_buf_linearize(rd->iov[i].iov_base, rd->iov[i].iov_len,
+					    data->rx_buf, offset, data_len - offset);
+	}
+
+	rd->recv = offset;
+	rd->trunc = offset < data_len;
+	data->rx_buf = net_buf_skip(data->rx_buf, data_len);
+	mgsm_sock_read_done(rd, data_len);
+
+	return 0;
+}
+
+/* Handler: +QIRD: <total_recv_len>[0],<have_read_len>[1],<unread_len>[2] */
+MODEM_CMD_DEFINE(on_cmd_sock_unread)
+{
+	mgsm.sock_query = atoi(argv[2]);
+
+	/* Updated on the RX thread for the same reason as mgsm_sock_read_done() */
+	(void)modem_socket_packet_size_update(&mgsm.socket_config, mgsm.sock_query_sock,
+					      mgsm.sock_query);
+	return 0;
+}
+
+/* Handler: +QISEND: <total_send_len>[0],<acked_bytes>[1],<unacked_bytes>[2] */
+MODEM_CMD_DEFINE(on_cmd_sock_unacked)
+{
+	mgsm.sock_query = atoi(argv[2]);
+	return 0;
+}
+
+/* Handler: > */
+MODEM_CMD_DIRECT_DEFINE(on_cmd_tx_ready)
+{
+	k_sem_give(&mgsm.sem_tx_ready);
+	return len;
+}
+
+static const struct modem_cmd unsol_cmds[] = {
+	MODEM_CMD_DIRECT("> ", on_cmd_tx_ready),
+	MODEM_CMD("+QIOPEN: ", on_cmd_sock_open, 2U, ","),
+	MODEM_CMD_ARGS_MAX("+QIURC: ", on_cmd_sock_urc, 2U, 4U, ","),
+#if defined(CONFIG_MODEM_MGSM_SOCKET_TLS)
+	MODEM_CMD("+QSSLOPEN: ", on_cmd_sock_open, 2U, ","),
+	MODEM_CMD("+QSSLURC: ", on_cmd_sock_urc, 2U, ","),
+#endif
+};
+
+static const struct modem_cmd sock_read_cmd =
+	MODEM_CMD("+QIRD: ", on_cmd_sock_readdata, 1U, "");
+
+#if defined(CONFIG_MODEM_MGSM_SOCKET_TLS)
+static const struct modem_cmd sock_tls_read_cmd =
+	MODEM_CMD("+QSSLRECV: ", on_cmd_sock_readdata, 1U, "");
+#endif
+
+static const struct modem_cmd sock_unread_cmd =
+	MODEM_CMD("+QIRD: ", on_cmd_sock_unread, 3U, ",");
+
+static const struct modem_cmd sock_unacked_cmd =
+	MODEM_CMD("+QISEND: ", on_cmd_sock_unacked, 3U, ",");
+
+/* Sends a command whose handler stores its result in sock_query */
+static int mgsm_sock_query(struct modem_socket *sock, const struct modem_cmd *cmd,
+			   const char *buf)
+{
+	int ret;
+
+	(void)modem_cmd_handler_tx_lock(&mgsm.context.cmd_handler, K_FOREVER);
+	mgsm.sock_query = -1;
+	mgsm.sock_query_sock = sock;
+	ret = modem_cmd_send_nolock(&mgsm.context.iface, &mgsm.context.cmd_handler,
+				    cmd, 1U, buf, &mgsm.sem_response, MGSM_CMD_AT_TIMEOUT);
+	if (ret == 0) {
+		ret = mgsm.sock_query < 0 ? -EIO : mgsm.sock_query;
+	}
+	modem_cmd_handler_tx_unlock(&mgsm.context.cmd_handler);
+
+	return ret;
+}
+
+/*
+ * Reads into iov, at most len bytes in total, returns the number read.
+ * A datagram is always read whole, as the modem drops what is not read,
+ * and trunc tells whether it was larger than len.
+ */
+static int mgsm_sock_read(struct modem_socket *sock, const struct iovec *iov, int iovcnt,
+			  size_t len, bool *trunc)
+{
+	struct mgsm_sock_read *rd = &mgsm.sock_read;
+	const struct modem_cmd *read_cmd = &sock_read_cmd;
+	char cmd[sizeof("AT+QSSLRECV=##,#####")];
+	int ret;
+
+#if defined(CONFIG_MODEM_MGSM_SOCKET_TLS)
+	if (mgsm_sock_tls(sock)) {
+		read_cmd = &sock_tls_read_cmd;
+	}
+#endif
+
+	len = sock->type == SOCK_DGRAM ? MGSM_SOCKET_MAX_DATA_LEN :
+					 MIN(len, MGSM_SOCKET_MAX_DATA_LEN);
+	snprintk(cmd, sizeof(cmd), "AT+%s=%d,%zu", mgsm_sock_tls(sock) ? "QSSLRECV" : "QIRD",
+		 sock->id, len);
+
+	/* rd is used by the RX thread until the response is complete */
+	(void)modem_cmd_handler_tx_lock(&mgsm.context.cmd_handler, K_FOREVER);
+	rd->sock = sock;
+	rd->iov = iov;
+	rd->iovcnt = iovcnt;
+	rd->req = len;
+	rd->recv = 0;
+	rd->trunc = false;
+	ret = modem_cmd_send_nolock(&mgsm.context.iface, &mgsm.context.cmd_handler,
+				    read_cmd, 1U, cmd, &mgsm.sem_response,
+				    MGSM_CMD_AT_TIMEOUT);
+	if (ret == 0) {
+		ret = rd->recv;
+		if (trunc) {
+			*trunc = rd->trunc;
+		}
+	}
+	rd->iov = NULL;
+	modem_cmd_handler_tx_unlock(&mgsm.context.cmd_handler);
+
+	return ret;
+}
+
+#if defined(CONFIG_MGSM_MODEM_SOCKET_RX_CACHE)
+/* Moves as much of the unread data as fits to the receive cache */
+static void mgsm_sock_fill_work(struct k_work *work)
+{
+	struct mgsm_socket_data *sd = CONTAINER_OF(work, struct mgsm_socket_data, fill_work);
+	struct modem_socket *sock = sd->sock;
+	char cmd[sizeof("AT+QIRD=##,0")];
+	struct iovec iov;
+	size_t len;
+	int ret;
+
+	snprintk(cmd, sizeof(cmd), "AT+QIRD=%d,0", sock->id);
+	ret = mgsm_sock_query(sock, &sock_unread_cmd, cmd);
+	if (ret < 0) {
+		LOG_WRN("socket %d unread length error %d", sock->id, ret);
+		goto error;
+	}
+
+	len = modem_socket_rx_cache_fill_len(&mgsm.socket_config, sock);
+	if (len == 0) {
+		goto wake;
+	}
+
+	iov.iov_base = mgsm.sock_fill_buf;
+	iov.iov_len = MIN(len, MIN(sizeof(mgsm.sock_fill_buf), MGSM_SOCKET_MAX_DATA_LEN));
+	ret = mgsm_sock_read(sock, &iov, 1, iov.iov_len, NULL);
+	if (ret < 0) {
+		LOG_WRN("socket %d read error %d", sock->id, ret);
+		goto error;
+	} else if (ret > 0) {
+		(void)modem_socket_rx_cache_fill(&mgsm.socket_config, sock,
+						 mgsm.sock_fill_buf, ret);
+	}
+
+	/* Data that arrived after the query does not bring a URC */
+	if (ret == iov.iov_len &&
+	    modem_socket_next_packet_size(&mgsm.socket_config, sock) == 0U) {
+		(void)modem_socket_packet_size_update(&mgsm.socket_config, sock, 1);
+	}
+
+	goto wake;
+
+error:
+	/* Not retried until the next URC, the reader gets the error instead */
+	(void)modem_socket_packet_size_update(&mgsm.socket_config, sock, 0);
+	sd->fill_err = ret;
+
+wake:
+	modem_socket_data_ready(&mgsm.socket_config, sock);
+}
+
+/* Returns and clears the error of the last failed fill */
+static int mgsm_sock_fill_error(struct modem_socket *sock)
+{
+	struct mgsm_socket_data *sd = sock->data;
+	int err = sd->fill_err;
+
+	sd->fill_err = 0;
+	return err;
+}
+#else
+static inline int mgsm_sock_fill_error(struct modem_socket *sock)
+{
+	ARG_UNUSED(sock);
+
+	return 0;
+}
+#endif
+
+/* Polls the acknowledged data until the modem has room again */
+static void mgsm_sock_window_work(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct mgsm_socket_data *sd = CONTAINER_OF(dwork, struct mgsm_socket_data, window_work);
+	struct modem_socket *sock = sd->sock;
+	char cmd[sizeof("AT+QISEND=##,0")];
+	int ret;
+
+	if (!sock->is_connected) {
+		return;
+	}
+
+	if (mgsm_sock_tls(sock)) {
+		/* AT+QSSLSEND has no acknowledgement query, the delay has to do */
+		modem_socket_send_window_update(&mgsm.socket_config, sock,
+						CONFIG_MODEM_MGSM_SOCKET_TX_WINDOW);
+		return;
+	}
+
+	snprintk(cmd, sizeof(cmd), "AT+QISEND=%d,0", sock->id);
+	ret = mgsm_sock_query(sock, &sock_unacked_cmd, cmd);
+	if (ret >= 0 && ret < CONFIG_MODEM_MGSM_SOCKET_TX_WINDOW) {
+		modem_socket_send_window_update(&mgsm.socket_config, sock,
+						CONFIG_MODEM_MGSM_SOCKET_TX_WINDOW - ret);
+		return;
+	}
+
+	(void)mgsm_work_reschedule(&sd->window_work, MGSM_SOCKET_WINDOW_POLL_DELAY);
+}
+
+/* Sends len bytes of iov with AT+QISEND or AT+QSSLSEND, the iov entries are written as they are */
+static int mgsm_sock_send_data(struct modem_socket *sock, const struct iovec *iov,
+			       int iovcnt, size_t len)
+{
+	struct mgsm_socket_data *sd = sock->data;
+	struct iovec out[MGSM_SOCKET_IOV_BATCH];
+	struct k_poll_event events[2];
+	char cmd[sizeof("AT+QSSLSEND=##,####")];
+	size_t left = len;
+	int i, n = 0;
+	int ret;
+
+	snprintk(cmd, sizeof(cmd), "AT+%s=%d,%zu", mgsm_sock_tls(sock) ? "QSSLSEND" : "QISEND",
+		 sock->id, len);
+
+	(void)modem_cmd_handler_tx_lock(&mgsm.context.cmd_handler, K_FOREVER);
+
+	k_sem_reset(&mgsm.sem_tx_ready);
+	k_sem_reset(&mgsm.sem_response);
+	ret = modem_cmd_send_nolock(&mgsm.context.iface, &mgsm.context.cmd_handler,
+				    NULL, 0U, cmd, NULL, K_NO_WAIT);
+	if (ret < 0) {
+		goto unlock;
+	}
+
+	/* The prompt, or ERROR if the socket is not usable */
+	k_poll_event_init(&events[0], K_POLL_TYPE_SEM_AVAILABLE, K_POLL_MODE_NOTIFY_ONLY,
+			  &mgsm.sem_tx_ready);
+	k_poll_event_init(&events[1], K_POLL_TYPE_SEM_AVAILABLE, K_POLL_MODE_NOTIFY_ONLY,
+			  &mgsm.sem_response);
+	if (k_poll(events, ARRAY_SIZE(events), MGSM_SOCKET_PROMPT_TIMEOUT) < 0) {
+		ret = -ETIMEDOUT;
+		goto unlock;
+	}
+
+	if (k_sem_take(&mgsm.sem_tx_ready, K_NO_WAIT) < 0) {
+		ret = modem_cmd_handler_get_error(&mgsm.cmd_handler_data);
+		ret = ret < 0 ? ret : -EIO;
+		goto unlock;
+	}
+
+	for (i = 0; i < iovcnt && left > 0; i++) {
+		out[n].iov_base = iov[i].iov_base;
+		out[n].iov_len = MIN(iov[i].iov_len, left);
+		left -= out[n].iov_len;
+
+		if (++n == ARRAY_SIZE(out) || left == 0) {
+			(void)modem_iface_writev(&mgsm.context.iface, out, n);
+			n = 0;
+		}
+	}
+
+	/* SEND OK or SEND FAIL */
+	ret = k_sem_take(&mgsm.sem_response, MGSM_SOCKET_SEND_TIMEOUT);
+	if (ret == 0) {
+		ret = modem_cmd_handler_get_error(&mgsm.cmd_handler_data);
+	} else {
+		ret = -ETIMEDOUT;
+	}
+
+unlock:
+	modem_cmd_handler_tx_unlock(&mgsm.context.cmd_handler);
+
+	if (ret == 0) {
+		if (modem_socket_send_window_consume(&mgsm.socket_config, sock, len) == 0U) {
+			(void)mgsm_work_reschedule(&sd->window_work, mgsm_sock_tls(sock) ?
+						   MGSM_SOCKET_WINDOW_POLL_DELAY : K_NO_WAIT);
+		}
+	} else if (ret == -EAGAIN) {
+		modem_socket_send_window_update(&mgsm.socket_config, sock, 0U);
+		(void)mgsm_work_reschedule(&sd->window_work, MGSM_SOCKET_WINDOW_POLL_DELAY);
+	}
+
+	return ret;
+}
+
+static int mgsm_sock_wait_writable(struct modem_socket *sock)
+{
+	struct k_poll_event event;
+
+	k_poll_event_init(&event, K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY,
+			  &sock->sig_send_ready);
+	if (k_poll(&event, 1, MGSM_SOCKET_SEND_TIMEOUT) < 0) {
+		return -EAGAIN;
+	}
+
+	return sock->is_connected ? 0 : -ENOTCONN;
+}
+
+static int mgsm_sock_addr_to_str(const struct sockaddr *addr, char *buf, size_t len,
+				 uint16_t *port)
+{
+	if (addr->sa_family == AF_INET6) {
+		net_addr_ntop(AF_INET6, &net_sin6(addr)->sin6_addr, buf, len);
+		*port = ntohs(net_sin6(addr)->sin6_port);
+	} else if (addr->sa_family == AF_INET) {
+		net_addr_ntop(AF_INET, &net_sin(addr)->sin_addr, buf, len);
+		*port = ntohs(net_sin(addr)->sin_port);
+	} else {
+		return -EAFNOSUPPORT;
+	}
+
+	return 0;
+}
+
+#if defined(CONFIG_MODEM_MGSM_SOCKET_TLS)
+static const struct mgsm_tls_cred {
+	enum tls_credential_type type;
+	/* AT+QSSLCFG setting and file name suffix */
+	const char *cfg;
+	const char *suffix;
+} mgsm_tls_creds[] = {
+	{ TLS_CREDENTIAL_CA_CERTIFICATE, "cacert", "ca" },
+	{ TLS_CREDENTIAL_SERVER_CERTIFICATE, "clientcert", "crt" },
+	{ TLS_CREDENTIAL_PRIVATE_KEY, "clientkey", "key" },
+};
+
+#define MGSM_TLS_FILE_NAME "UFS:%d_%s.pem"
+#define MGSM_TLS_FILE_NAME_LEN sizeof("UFS:-##########_crt.pem")
+
+/* Stores a credential in the modem file system, -ENOENT if the tag has none.
+ * Called with tls_lock held.
+ */
+static int mgsm_tls_upload(sec_tag_t tag, enum tls_credential_type type, const char *name)
+{
+	char buf[sizeof("AT+QFUPL=\"\",#####") + MGSM_TLS_FILE_NAME_LEN];
+	size_t len = sizeof(mgsm.tls_cred_buf);
+	int ret;
+
+	ret = tls_credential_get(tag, type, mgsm.tls_cred_buf, &len);
+	if (ret < 0) {
+		return ret;
+	}
+
+	/* AT+QFUPL does not overwrite files */
+	snprintk(buf, sizeof(buf), "AT+QFDEL=\"%s\"", name);
+	(void)modem_cmd_send(&mgsm.context.iface, &mgsm.context.cmd_handler,
+			     NULL, 0U, buf, &mgsm.sem_response, MGSM_CMD_AT_TIMEOUT);
+
+	snprintk(buf, sizeof(buf), "AT+QFUPL=\"%s\",%zu", name, len);
+
+	(void)modem_cmd_handler_tx_lock(&mgsm.context.cmd_handler, K_FOREVER);
+
+	/* CONNECT, then the file content */
+	ret = modem_cmd_send_nolock(&mgsm.context.iface, &mgsm.context.cmd_handler,
+				    NULL, 0U, buf, &mgsm.sem_response, MGSM_CMD_AT_TIMEOUT);
+	if (ret == 0) {
+		(void)modem_iface_writev(&mgsm.context.iface, (struct iovec[]) {
+			{ .iov_base = mgsm.tls_cred_buf, .iov_len = len },
+		}, 1);
+
+		ret = k_sem_take(&mgsm.sem_response, MGSM_TLS_UPLOAD_TIMEOUT);
+		if (ret == 0) {
+			ret = modem_cmd_handler_get_error(&mgsm.cmd_handler_data);
+		} else {
+			ret = -ETIMEDOUT;
+		}
+	}
+
+	modem_cmd_handler_tx_unlock(&mgsm.context.cmd_handler);
+
+	if (ret < 0) {
+		LOG_ERR("%s ret:%d", buf, ret);
+	}
+
+	return ret;
+}
+
+/* Returns BIT(type) of the credentials of tag stored in the modem */
+static int mgsm_tls_tag_upload(sec_tag_t tag)
+{
+	struct mgsm_tls_tag *entry;
+	char name[MGSM_TLS_FILE_NAME_LEN];
+	uint8_t types = 0;
+	size_t i;
+	int ret;
+
+	(void)k_mutex_lock(&mgsm.tls_lock, K_FOREVER);
+
+	for (i = 0; i < mgsm.tls_tags_len; i++) {
+		if (mgsm.tls_tags[i].tag == tag) {
+			ret = mgsm.tls_tags[i].types;
+			goto out;
+		}
+	}
+
+	for (i = 0; i < ARRAY_SIZE(mgsm_tls_creds); i++) {
+		snprintk(name, sizeof(name), MGSM_TLS_FILE_NAME, tag, mgsm_tls_creds[i].suffix);
+		ret = mgsm_tls_upload(tag, mgsm_tls_creds[i].type, name);
+		if (ret == -ENOENT) {
+			continue;
+		} else if (ret < 0) {
+			goto out;
+		}
+
+		types |= BIT(mgsm_tls_creds[i].type);
+	}
+
+	entry = &mgsm.tls_tags[mgsm.tls_tags_next];
+	entry->tag = tag;
+	entry->types = types;
+	mgsm.tls_tags_next = (mgsm.tls_tags_next + 1) % ARRAY_SIZE(mgsm.tls_tags);
+	mgsm.tls_tags_len = MIN(mgsm.tls_tags_len + 1, ARRAY_SIZE(mgsm.tls_tags));
+	ret = types;
+
+out:
+	(void)k_mutex_unlock(&mgsm.tls_lock);
+
+	return ret;
+}
+
+/* Configures the SSL context of the socket with its credentials */
+static int mgsm_sock_tls_setup(struct modem_socket *sock)
+{
+	struct mgsm_socket_data *sd = sock->data;
+	char buf[sizeof("AT+QSSLCFG=\"clientcert\",#,\"\"") + MGSM_TLS_FILE_NAME_LEN];
+	char name[MGSM_TLS_FILE_NAME_LEN];
+	int types = 0, seclevel = 0;
+	size_t i;
+	int ret;
+
+	if (sock->id >= MGSM_TLS_CTX_MAX) {
+		LOG_ERR("no SSL context for socket %d", sock->id);
+		return -ENOBUFS;
+	}
+
+	if (sd->sec_tag != MGSM_TLS_TAG_NONE) {
+		types = mgsm_tls_tag_upload(sd->sec_tag);
+		if (types < 0) {
+			return types;
+		}
+	}
+
+	/* 0: no authentication, 1: server, 2: server and client */
+	if (sd->peer_verify != TLS_PEER_VERIFY_NONE) {
+		if (!(types & BIT(TLS_CREDENTIAL_CA_CERTIFICATE))) {
+			LOG_ERR("no CA certificate for socket %d", sock->id);
+			return -EINVAL;
+		}
+
+		seclevel = 1;
+	}
+
+	if ((types & BIT(TLS_CREDENTIAL_SERVER_CERTIFICATE)) &&
+	    (types & BIT(TLS_CREDENTIAL_PRIVATE_KEY))) {
+		seclevel = 2;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(mgsm_tls_creds); i++) {
+		if (!(types & BIT(mgsm_tls_creds[i].type))) {
+			continue;
+		}
+
+		snprintk(name, sizeof(name), MGSM_TLS_FILE_NAME, sd->sec_tag,
+			 mgsm_tls_creds[i].suffix);
+		snprintk(buf, sizeof(buf), "AT+QSSLCFG=\"%s\",%d,\"%s\"", mgsm_tls_creds[i].cfg,
+			 sock->id, name);
+		ret = modem_cmd_send(&mgsm.context.iface, &mgsm.context.cmd_handler,
+				     NULL, 0U, buf, &mgsm.sem_response, MGSM_CMD_AT_TIMEOUT);
+		if (ret < 0) {
+			goto error;
+		}
+	}
+
+	/* TLS 1.2 with all cipher suites */
+	snprintk(buf, sizeof(buf), "AT+QSSLCFG=\"sslversion\",%d,3", sock->id);
+	ret = modem_cmd_send(&mgsm.context.iface, &mgsm.context.cmd_handler,
+			     NULL, 0U, buf, &mgsm.sem_response, MGSM_CMD_AT_TIMEOUT);
+	if (ret < 0) {
+		goto error;
+	}
+
+	snprintk(buf, sizeof(buf), "AT+QSSLCFG=\"ciphersuite\",%d,0XFFFF", sock->id);
+	ret = modem_cmd_send(&mgsm.context.iface, &mgsm.context.cmd_handler,
+			     NULL, 0U, buf, &mgsm.sem_response, MGSM_CMD_AT_TIMEOUT);
+	if (ret < 0) {
+		goto error;
+	}
+
+	snprintk(buf, sizeof(buf), "AT+QSSLCFG=\"seclevel\",%d,%d", sock->id, seclevel);
+	ret = modem_cmd_send(&mgsm.context.iface, &mgsm.context.cmd_handler,
+			     NULL, 0U, buf, &mgsm.sem_response, MGSM_CMD_AT_TIMEOUT);
+	if (ret < 0) {
+		goto error;
+	}
+
+	/* Server name indication with the AT+QSSLOPEN host name */
+	snprintk(buf, sizeof(buf), "AT+QSSLCFG=\"sni\",%d,%d", sock->id,
+		 sd->hostname[0] != '\0');
+	ret = modem_cmd_send(&mgsm.context.iface, &mgsm.context.cmd_handler,
+			     NULL, 0U, buf, &mgsm.sem_response, MGSM_CMD_AT_TIMEOUT);
+	if (ret < 0) {
+		goto error;
+	}
+
+	return 0;
+
+error:
+	LOG_ERR("%s ret:%d", buf, ret);
+	return ret;
+}
+
+/* SOL_TLS options of TLS sockets */
+static int mgsm_sock_tls_setsockopt(struct modem_socket *sock, int optname,
+				    const void *optval, socklen_t optlen)
+{
+	struct mgsm_socket_data *sd = sock->data;
+
+	switch (optname) {
+	case TLS_SEC_TAG_LIST:
+		if (optlen < sizeof(sec_tag_t) || optlen % sizeof(sec_tag_t) != 0) {
+			errno = EINVAL;
+			return -1;
+		}
+
+		/* An SSL context takes a single set of credentials */
+		if (optlen > sizeof(sec_tag_t)) {
+			LOG_WRN("only the first tag is used");
+		}
+
+		sd->sec_tag = *(const sec_tag_t *)optval;
+		break;
+	case TLS_PEER_VERIFY:
+		if (optlen != sizeof(int)) {
+			errno = EINVAL;
+			return -1;
+		}
+
+		sd->peer_verify = *(const int *)optval;
+		break;
+	case TLS_HOSTNAME:
+		/* Replaces the numeric AT+QSSLOPEN address, NULL clears it */
+		if (optval == NULL) {
+			sd->hostname[0] = '\0';
+			break;
+		}
+
+		optlen = strnlen(optval, optlen);
+		if (optlen >= sizeof(sd->hostname)) {
+			errno = EINVAL;
+			return -1;
+		}
+
+		memcpy(sd->hostname, optval, optlen);
+		sd->hostname[optlen] = '\0';
+		break;
+	default:
+		errno = ENOPROTOOPT;
+		return -1;
+	}
+
+	return 0;
+}
+
+/* AT+QSSLOPEN address: the TLS_HOSTNAME if set, else the numeric address */
+static const char *mgsm_sock_tls_host(struct modem_socket *sock, const char *ip_str)
+{
+	struct mgsm_socket_data *sd = sock->data;
+
+	return sd->hostname[0] != '\0' ? sd->hostname : ip_str;
+}
+#else
+static inline int mgsm_sock_tls_setup(struct modem_socket *sock)
+{
+	ARG_UNUSED(sock);
+
+	return -ENOTSUP;
+}
+
+static inline const char *mgsm_sock_tls_host(struct modem_socket *sock, const char *ip_str)
+{
+	ARG_UNUSED(sock);
+
+	return ip_str;
+}
+#endif /* CONFIG_MODEM_MGSM_SOCKET_TLS */
+
+static int offload_socket(int family, int type, int proto)
+{
+	int ret;
+
+	ret = modem_socket_get(&mgsm.socket_config, family, type, proto);
+	if (ret < 0) {
+		errno = -ret;
+		return -1;
+	}
+
+#if defined(CONFIG_MODEM_MGSM_SOCKET_TLS)
+	{
+		struct modem_socket *sock = modem_socket_from_fd(&mgsm.socket_config, ret);
+		struct mgsm_socket_data *sd = sock->data;
+
+		sd->sec_tag = MGSM_TLS_TAG_NONE;
+		sd->peer_verify = TLS_PEER_VERIFY_REQUIRED;
+		sd->hostname[0] = '\0';
+	}
+#endif
+
+	errno = 0;
+	return ret;
+}
+
+static int offload_close(void *obj)
+{
+	struct modem_socket *sock = obj;
+	struct mgsm_socket_data *sd = sock->data;
+	char buf[sizeof("AT+QSSLCLOSE=##")];
+	struct k_work_sync work_sync;
+	int ret;
+
+	if (!modem_socket_id_is_assigned(&mgsm.socket_config, sock)) {
+		return 0;
+	}
+
+	/* The connect id is only free again after AT+QICLOSE */
+	if (sd->opened) {
+		snprintk(buf, sizeof(buf), "AT+%s=%d", mgsm_sock_tls(sock) ? "QSSLCLOSE" : "QICLOSE",
+			 sock->id);
+		ret = modem_cmd_send(&mgsm.context.iface, &mgsm.context.cmd_handler,
+				     NULL, 0U, buf, &mgsm.sem_response,
+				     MGSM_SOCKET_CLOSE_TIMEOUT);
+		if (ret < 0) {
+			LOG_ERR("%s ret:%d", buf, ret);
+		}
+
+		sd->opened = false;
+	}
+
+	sock->is_connected = false;
+	(void)k_work_cancel_delayable_sync(&sd->window_work, &work_sync);
+#if defined(CONFIG_MGSM_MODEM_SOCKET_RX_CACHE)
+	(void)k_work_cancel_sync(&sd->fill_work, &work_sync);
+	sd->fill_err = 0;
+#endif
+	modem_socket_put(&mgsm.socket_config, sock->sock_fd);
+
+	return 0;
+}
+
+static int offload_bind(void *obj, const struct sockaddr *addr, socklen_t addrlen)
+{
+	struct modem_socket *sock = obj;
+
+	if (sock->is_connected) {
+		errno = EISCONN;
+		return -1;
+	}
+
+	memcpy(&sock->src, addr, MIN(addrlen, sizeof(sock->src)));
+
+	return 0;
+}
+
+static int offload_connect(void *obj, const struct sockaddr *addr, socklen_t addrlen)
+{
+	struct modem_socket *sock = obj;
+	struct mgsm_socket_data *sd = sock->data;
+	char ip_str[NET_IPV6_ADDR_LEN];
+	char buf[sizeof("AT+QIOPEN=1,##,\"TCP\",\"\",#####,#####,0") +
+		 MAX(NET_IPV6_ADDR_LEN, MGSM_TLS_HOST_LEN)];
+	uint16_t dst_port, src_port = 0;
+	uint32_t start;
+	int ret;
+
+	if (sock->is_connected) {
+		errno = EISCONN;
+		return -1;
+	}
+
+	if (mgsm.state != MGSM_PPP_SETUP_DONE) {
+		errno = ENETUNREACH;
+		return -1;
+	}
+
+	ret = mgsm_sock_addr_to_str(addr, ip_str, sizeof(ip_str), &dst_port);
+	if (ret < 0) {
+		goto error;
+	}
+
+	if (sock->src.sa_family == addr->sa_family) {
+		char src_str[NET_IPV6_ADDR_LEN];
+
+		(void)mgsm_sock_addr_to_str(&sock->src, src_str, sizeof(src_str), &src_port);
+	}
+
+	start = k_uptime_get_32();
+
+	if (mgsm_sock_tls(sock)) {
+		ret = mgsm_sock_tls_setup(sock);
+		if (ret < 0) {
+			goto error;
+		}
+
+		/* The SSL context id is the connect id, the host name is the server name */
+		snprintk(buf, sizeof(buf), "AT+QSSLOPEN=1,%d,%d,\"%s\",%u,0", sock->id,
+			 sock->id, mgsm_sock_tls_host(sock, ip_str), dst_port);
+	} else {
+		snprintk(buf, sizeof(buf), "AT+QIOPEN=1,%d,\"%s\",\"%s\",%u,%u,0", sock->id,
+			 sock->type == SOCK_DGRAM ? "UDP" : "TCP", ip_str, dst_port, src_port);
+	}
+
+	k_sem_reset(&sd->sem_open);
+	ret = modem_cmd_send(&mgsm.context.iface, &mgsm.context.cmd_handler,
+			     NULL, 0U, buf, &mgsm.sem_response, MGSM_CMD_AT_TIMEOUT);
+	if (ret < 0) {
+		LOG_ERR("%s ret:%d", buf, ret);
+		goto error;
+	}
+
+	sd->opened = true;
+
+	/* The result comes as +QIOPEN or +QSSLOPEN URC, after the TLS handshake */
+	ret = k_sem_take(&sd->sem_open, MGSM_SOCKET_OPEN_TIMEOUT);
+	if (ret < 0) {
+		ret = -ETIMEDOUT;
+		goto error;
+	}
+
+	if (sd->open_err != 0) {
+		LOG_ERR("socket %d open error %d", sock->id, sd->open_err);
+		ret = -ECONNREFUSED;
+		goto error;
+	}
+
+	memcpy(&sock->dst, addr, MIN(addrlen, sizeof(sock->dst)));
+	sock->is_connected = true;
+	modem_socket_send_window_update(&mgsm.socket_config, sock,
+					CONFIG_MODEM_MGSM_SOCKET_TX_WINDOW);
+
+	LOG_INF("socket %d %s connected in %u ms", sock->id,
+		mgsm_sock_tls(sock) ? "TLS" : (sock->type == SOCK_DGRAM ? "UDP" : "TCP"),
+		k_uptime_get_32() - start);
+
+	errno = 0;
+	return 0;
+
+error:
+	errno = -ret;
+	return -1;
+}
+
+static ssize_t mgsm_sock_send(struct modem_socket *sock, const struct iovec *iov, int iovcnt,
+			      int flags, const struct sockaddr *to, socklen_t tolen)
+{
+	size_t len = 0;
+	uint32_t window;
+	int ret, i;
+
+	for (i = 0; i < iovcnt; i++) {
+		len += iov[i].iov_len;
+	}
+
+	if (!sock->is_connected) {
+		/* UDP sockets are opened towards the first destination */
+		if (sock->type != SOCK_DGRAM || !to) {
+			errno = ENOTCONN;
+			return -1;
+		}
+
+		if (offload_connect(sock, to, tolen) < 0) {
+			return -1;
+		}
+	}
+
+	if (len > MGSM_SOCKET_MAX_DATA_LEN) {
+		if (sock->type == SOCK_DGRAM) {
+			errno = EMSGSIZE;
+			return -1;
+		}
+
+		/* Stream sockets send what fits, like a short write */
+		len = MGSM_SOCKET_MAX_DATA_LEN;
+	}
+
+	while (true) {
+		/* Nothing is sent while the window is closed, streams send what fits */
+		window = modem_socket_send_window(sock);
+		if (window == 0U) {
+			ret = -EAGAIN;
+		} else {
+			if (sock->type == SOCK_STREAM) {
+				len = MIN(len, window);
+			}
+
+			ret = mgsm_sock_send_data(sock, iov, iovcnt, len);
+		}
+
+		if (ret != -EAGAIN || (flags & ZSOCK_MSG_DONTWAIT)) {
+			break;
+		}
+
+		ret = mgsm_sock_wait_writable(sock);
+		if (ret < 0) {
+			break;
+		}
+	}
+
+	if (ret < 0) {
+		errno = -ret;
+		return -1;
+	}
+
+	errno = 0;
+	return len;
+}
+
+static ssize_t offload_sendto(void *obj, const void *buf, size_t len, int flags,
+			      const struct sockaddr *to, socklen_t tolen)
+{
+	struct iovec iov = {
+		.iov_base = (void *)buf,
+		.iov_len = len,
+	};
+
+	return mgsm_sock_send(obj, &iov, 1, flags, to, tolen);
+}
+
+static ssize_t offload_sendmsg(void *obj, const struct msghdr *msg, int flags)
+{
+	if (!msg) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* A single send command, the buffers are written to the modem in turn */
+	return mgsm_sock_send(obj, msg->msg_iov, msg->msg_iovlen, flags,
+			      msg->msg_name, msg->msg_namelen);
+}
+
+/* Reads the receive cache into iov, returns the number of bytes copied */
+static size_t mgsm_sock_cache_readv(struct modem_socket *sock, const struct iovec *iov,
+				    int iovcnt)
+{
+	size_t total = 0, n;
+	int i;
+
+	for (i = 0; i < iovcnt; i++) {
+		n = modem_socket_rx_cache_read(&mgsm.socket_config, sock,
+					       iov[i].iov_base, iov[i].iov_len);
+		total += n;
+		if (n < iov[i].iov_len) {
+			break;
+		}
+	}
+
+	return total;
+}
+
+/*
+ * The modem returns one datagram per AT+QIRD, so datagrams are read one
+ * by one, each scattered over iov. msg_flags, if not NULL, gets
+ * ZSOCK_MSG_TRUNC for a datagram larger than iov.
+ */
+static ssize_t mgsm_sock_recv(struct modem_socket *sock, const struct iovec *iov, int iovcnt,
+			      int flags, struct sockaddr *from, socklen_t *fromlen,
+			      int *msg_flags)
+{
+	k_timepoint_t deadline;
+	bool trunc = false;
+	size_t len = 0;
+	int ret, i;
+
+	for (i = 0; i < iovcnt; i++) {
+		len += iov[i].iov_len;
+	}
+
+	if (len == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (flags & ZSOCK_MSG_PEEK) {
+		errno = ENOTSUP;
+		return -1;
+	}
+
+	/* SO_RCVTIMEO bounds the whole call, not each wake-up */
+	deadline = sys_timepoint_calc(modem_socket_recv_timeout(sock, flags));
+
+	while (true) {
+		modem_socket_wait_prepare(&mgsm.socket_config, sock);
+
+		if (mgsm_sock_cached(sock)) {
+			ret = mgsm_sock_cache_readv(sock, iov, iovcnt);
+			if (ret > 0) {
+				break;
+			}
+
+			ret = mgsm_sock_fill_error(sock);
+			if (ret < 0) {
+				errno = -ret;
+				ret = -1;
+				goto done;
+			}
+		}
+
+		if (modem_socket_next_packet_size(&mgsm.socket_config, sock) > 0U) {
+#if defined(CONFIG_MGSM_MODEM_SOCKET_RX_CACHE)
+			if (mgsm_sock_cached(sock)) {
+				/* Cached data must be returned first, so reads go through the cache */
+				struct mgsm_socket_data *sd = sock->data;
+
+				(void)k_work_submit_to_queue(&mgsm.workq, &sd->fill_work);
+				goto wait;
+			}
+#endif
+			/* The pending marker is kept up to date by the read handler */
+			ret = mgsm_sock_read(sock, iov, iovcnt, len, &trunc);
+			if (ret < 0) {
+				errno = -ret;
+				ret = -1;
+				goto done;
+			}
+
+			if (ret > 0) {
+				break;
+			}
+
+			continue;
+		}
+
+		if (!sock->is_connected) {
+			if (sock->type == SOCK_STREAM) {
+				/* end of stream */
+				ret = 0;
+				break;
+			}
+
+			errno = ENOTCONN;
+			ret = -1;
+			goto done;
+		}
+
+#if defined(CONFIG_MGSM_MODEM_SOCKET_RX_CACHE)
+wait:
+#endif
+		ret = modem_socket_wait_data(&mgsm.socket_config, sock,
+					     sys_timepoint_timeout(deadline));
+		if (ret < 0) {
+			errno = EAGAIN;
+			ret = -1;
+			goto done;
+		}
+	}
+
+	/* The modem does not report the source of connected sockets */
+	if (from && fromlen) {
+		*fromlen = MIN(*fromlen, sizeof(sock->dst));
+		memcpy(from, &sock->dst, *fromlen);
+	}
+
+	if (msg_flags) {
+		*msg_flags = trunc ? ZSOCK_MSG_TRUNC : 0;
+	}
+
+	errno = 0;
+
+done:
+	/* Also on errors, so a wake-up that found no data is not left pending */
+	modem_socket_wait_done(&mgsm.socket_config, sock);
+	return ret;
+}
+
+static ssize_t offload_recvfrom(void *obj, void *buf, size_t len, int flags,
+				struct sockaddr *from, socklen_t *fromlen)
+{
+	struct iovec iov = {
+		.iov_base = buf,
+		.iov_len = len,
+	};
+
+	if (!buf) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return mgsm_sock_recv(obj, &iov, 1, flags, from, fromlen, NULL);
+}
+
+static ssize_t offload_recvmsg(void *obj, struct msghdr *msg, int flags)
+{
+	ssize_t ret;
+
+	if (!msg) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	ret = mgsm_sock_recv(obj, msg->msg_iov, msg->msg_iovlen, flags,
+			     msg->msg_name, &msg->msg_namelen, &msg->msg_flags);
+	if (ret >= 0) {
+		msg->msg_controllen = 0;
+	}
+
+	return ret;
+}
+
+static ssize_t offload_read(void *obj, void *buffer, size_t count)
+{
+	return offload_recvfrom(obj, buffer, count, 0, NULL, 0);
+}
+
+static ssize_t offload_write(void *obj, const void *buffer, size_t count)
+{
+	return offload_sendto(obj, buffer, count, 0, NULL, 0);
+}
+
+static int offload_ioctl(void *obj, unsigned int request, va_list args)
+{
+	switch (request) {
+	case ZFD_IOCTL_POLL_PREPARE: {
+		struct zsock_pollfd *pfd;
+		struct k_poll_event **pev;
+		struct k_poll_event *pev_end;
+
+		pfd = va_arg(args, struct zsock_pollfd *);
+		pev = va_arg(args, struct k_poll_event **);
+		pev_end = va_arg(args, struct k_poll_event *);
+
+		return modem_socket_poll_prepare(&mgsm.socket_config, obj, pfd, pev, pev_end);
+	}
+	case ZFD_IOCTL_POLL_UPDATE: {
+		struct zsock_pollfd *pfd;
+		struct k_poll_event **pev;
+
+		pfd = va_arg(args, struct zsock_pollfd *);
+		pev = va_arg(args, struct k_poll_event **);
+
+		return modem_socket_poll_update(obj, pfd, pev);
+	}
+	default:
+		errno = EINVAL;
+		return -1;
+	}
+}
+
+static int offload_setsockopt(void *obj, int level, int optname,
+			      const void *optval, socklen_t optlen)
+{
+	struct modem_socket *sock = obj;
+	int ret;
+
+	if (level == SOL_SOCKET && optname == SO_RCVTIMEO) {
+		ret = modem_socket_rcv_timeout_set(sock, optval, optlen);
+		if (ret < 0) {
+			errno = -ret;
+			return -1;
+		}
+
+		return 0;
+	}
+
+#if defined(CONFIG_MODEM_MGSM_SOCKET_TLS)
+	if (level == SOL_TLS && mgsm_sock_tls(sock)) {
+		return mgsm_sock_tls_setsockopt(sock, optname, optval, optlen);
+	}
+#endif
+
+	errno = ENOPROTOOPT;
+	return -1;
+}
+
+static const struct socket_op_vtable offload_socket_fd_op_vtable = {
+	.fd_vtable = {
+		.read = offload_read,
+		.write = offload_write,
+		.close = offload_close,
+		.ioctl = offload_ioctl,
+	},
+	.bind = offload_bind,
+	.connect = offload_connect,
+	.sendto = offload_sendto,
+	.recvfrom = offload_recvfrom,
+	.listen = NULL,
+	.accept = NULL,
+	.sendmsg = offload_sendmsg,
+	.recvmsg = offload_recvmsg,
+	.getsockopt = NULL,
+	.setsockopt = offload_setsockopt,
+};
+
+static bool offload_is_supported(int family, int type, int proto)
+{
+	if (family != AF_INET && family != AF_INET6) {
+		return false;
+	}
+
+	return (type == SOCK_STREAM && (proto == 0 || proto == IPPROTO_TCP)) ||
+	       (type == SOCK_DGRAM && (proto == 0 || proto == IPPROTO_UDP)) ||
+	       (IS_ENABLED(CONFIG_MODEM_MGSM_SOCKET_TLS) && type == SOCK_STREAM &&
+		proto == IPPROTO_TLS_1_2);
+}
+
+NET_SOCKET_OFFLOAD_REGISTER(mgsm, CONFIG_NET_SOCKETS_OFFLOAD_PRIORITY, AF_UNSPEC,
+			    offload_is_supported, offload_socket);
+
+#if defined(CONFIG_MODEM_MGSM_DNS_OFFLOAD)
+/* Entry to store the lookup of host in, an expired or the oldest one */
+static struct mgsm_dns_entry *mgsm_dns_slot(int64_t now)
+{
+	struct mgsm_dns_entry *slot = &mgsm.dns_cache[0];
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(mgsm.dns_cache); i++) {
+		struct mgsm_dns_entry *entry = &mgsm.dns_cache[i];
+
+		if (entry->host[0] == '\0' || entry->expires <= now) {
+			return entry;
+		}
+
+		if (entry->expires < slot->expires) {
+			slot = entry;
+		}
+	}
+
+	return slot;
+}
+
+/* Resolves host from the cache or with AT+QIDNSGIP, called with dns_lock held */
+static int mgsm_dns_lookup(const char *host, struct sockaddr *addr)
+{
+	char buf[sizeof("AT+QIDNSGIP=1,\"\"") + MGSM_DNS_HOST_LEN];
+	struct mgsm_dns_entry *slot = NULL;
+	int64_t now = k_uptime_get();
+	uint32_t ttl;
+	size_t i;
+	int ret;
+
+	if (strlen(host) >= MGSM_DNS_HOST_LEN) {
+		return DNS_EAI_FAIL;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(mgsm.dns_cache); i++) {
+		struct mgsm_dns_entry *entry = &mgsm.dns_cache[i];
+
+		if (strcmp(entry->host, host) != 0) {
+			continue;
+		}
+
+		if (entry->expires > now) {
+			LOG_DBG("%s cached", host);
+			if (entry->addr.sa_family == AF_UNSPEC) {
+				return DNS_EAI_NONAME;
+			}
+
+			memcpy(addr, &entry->addr, sizeof(*addr));
+			return 0;
+		}
+
+		slot = entry;
+		break;
+	}
+
+	snprintk(buf, sizeof(buf), "AT+QIDNSGIP=1,\"%s\"", host);
+
+	/* The result comes as +QIURC: "dnsgip" URCs */
+	k_sem_reset(&mgsm.sem_dns);
+	mgsm.dns_left = 0;
+	ret = modem_cmd_send(&mgsm.context.iface, &mgsm.context.cmd_handler,
+			     NULL, 0U, buf, &mgsm.sem_response, MGSM_CMD_AT_TIMEOUT);
+	if (ret < 0) {
+		LOG_ERR("%s ret:%d", buf, ret);
+		return DNS_EAI_FAIL;
+	}
+
+	if (k_sem_take(&mgsm.sem_dns, MGSM_DNS_TIMEOUT) < 0) {
+		/* Not cached, the next lookup tries again */
+		return DNS_EAI_AGAIN;
+	}
+
+	if (!slot) {
+		slot = mgsm_dns_slot(now);
+	}
+
+	strcpy(slot->host, host);
+
+	if (mgsm.dns_err != 0 || mgsm.dns_addr.sa_family == AF_UNSPEC) {
+		LOG_DBG("%s lookup error %d", host, mgsm.dns_err);
+		slot->addr.sa_family = AF_UNSPEC;
+		slot->expires = now + CONFIG_MODEM_MGSM_DNS_NEG_TTL * MSEC_PER_SEC;
+		return DNS_EAI_NONAME;
+	}
+
+	ttl = MIN(mgsm.dns_ttl, CONFIG_MODEM_MGSM_DNS_MAX_TTL);
+	memcpy(&slot->addr, &mgsm.dns_addr, sizeof(slot->addr));
+	slot->expires = now + (int64_t)ttl * MSEC_PER_SEC;
+	memcpy(addr, &slot->addr, sizeof(*addr));
+
+	return 0;
+}
+
+static int offload_getaddrinfo(const char *node, const char *service,
+			       const struct zsock_addrinfo *hints,
+			       struct zsock_addrinfo **res)
 {
-	/* Expected response is "+CGATT: 0|1" so simply look for '1' */
-	if ((argc > 0) && (atoi(argv[0]) == 1)) {
-		LOG_INF("Attached to packet service!");
+	struct sockaddr addr = { 0 };
+	struct zsock_addrinfo *ai;
+	long port = 0;
+	char *end;
+	int ret;
+
+	/* Passive lookups are not supported */
+	if (!node) {
+		return DNS_EAI_NONAME;
+	}
+
+	if (service) {
+		port = strtol(service, &end, 10);
+		if (*end != '\0' || port < 0 || port > UINT16_MAX) {
+			return DNS_EAI_SERVICE;
+		}
+	}
+
+	/* Numeric addresses need no lookup */
+	if (net_addr_pton(AF_INET, node, &net_sin(&addr)->sin_addr) == 0) {
+		addr.sa_family = AF_INET;
+	} else if (net_addr_pton(AF_INET6, node, &net_sin6(&addr)->sin6_addr) == 0) {
+		addr.sa_family = AF_INET6;
+	} else {
+		if (mgsm.state != MGSM_PPP_SETUP_DONE) {
+			return DNS_EAI_AGAIN;
+		}
+
+		(void)k_mutex_lock(&mgsm.dns_lock, K_FOREVER);
+		ret = mgsm_dns_lookup(node, &addr);
+		(void)k_mutex_unlock(&mgsm.dns_lock);
+		if (ret < 0) {
+			return ret;
+		}
+	}
+
+	if (hints && hints->ai_family != AF_UNSPEC && hints->ai_family != addr.sa_family) {
+		return DNS_EAI_NONAME;
+	}
+
+	ai = k_calloc(1, sizeof(*ai));
+	if (!ai) {
+		return DNS_EAI_MEMORY;
 	}
 
+	ai->ai_family = addr.sa_family;
+	ai->ai_socktype = (hints && hints->ai_socktype) ? hints->ai_socktype : SOCK_STREAM;
+	if (hints && hints->ai_protocol) {
+		ai->ai_protocol = hints->ai_protocol;
+	} else {
+		ai->ai_protocol = ai->ai_socktype == SOCK_DGRAM ? IPPROTO_UDP : IPPROTO_TCP;
+	}
+
+	ai->ai_addr = &ai->_ai_addr;
+	memcpy(ai->ai_addr, &addr, sizeof(addr));
+	if (addr.sa_family == AF_INET) {
+		net_sin(ai->ai_addr)->sin_port = htons(port);
+		ai->ai_addrlen = sizeof(struct sockaddr_in);
+	} else {
+		net_sin6(ai->ai_addr)->sin6_port = htons(port);
+		ai->ai_addrlen = sizeof(struct sockaddr_in6);
+	}
+
+	*res = ai;
+
 	return 0;
 }
 
+static void offload_freeaddrinfo(struct zsock_addrinfo *res)
+{
+	/* A single entry, see offload_getaddrinfo() */
+	k_free(res);
+}
 
-static const struct modem_cmd read_cops_cmd =
-	MODEM_CMD_ARGS_MAX("+COPS:", on_cmd_atcmdinfo_cops, 1U, 4U, ",");
+static const struct socket_dns_offload mgsm_dns_ops = {
+	.getaddrinfo = offload_getaddrinfo,
+	.freeaddrinfo = offload_freeaddrinfo,
+};
+#endif /* CONFIG_MODEM_MGSM_DNS_OFFLOAD */
 
-static const struct modem_cmd check_net_reg_cmd =
-	MODEM_CMD("+CEREG: ", on_cmd_net_reg_sts, 2U, ",");
+static void mgsm_offload_iface_init(struct net_if *iface)
+{
+	struct mgsm_modem *mgsm = net_if_get_device(iface)->data;
 
-static const struct modem_cmd check_attached_cmd =
-	MODEM_CMD("+CGATT:", on_cmd_atcmdinfo_attached, 1U, ",");
+	mgsm->iface = iface;
+	net_if_socket_offload_set(iface, offload_socket);
+#if defined(CONFIG_MODEM_MGSM_DNS_OFFLOAD)
+	socket_offload_dns_register(&mgsm_dns_ops);
+#endif
 
-static const struct modem_cmd check_ip_cmd = 
-	MODEM_CMD("+CGPADDR:", on_cmd_ipinfo, 2U, "," );
+	/* Up once the PDP context is active */
+	net_if_carrier_off(iface);
+}
 
-static const struct setup_cmd connect_cmds[] = {
-	/* connect to network */
-	SETUP_CMD_NOHANDLE("AT+CGPADDR"),
-	SETUP_CMD_NOHANDLE("ATD*99#"),
+static struct offloaded_if_api mgsm_offload_api = {
+	.iface_api.init = mgsm_offload_iface_init,
 };
 
-static int mgsm_query_modem_info(struct mgsm_modem *mgsm)
+static int mgsm_offload_init(struct mgsm_modem *mgsm)
 {
-	LOG_INF("!!! mgsm QUERY INFO");
+	size_t i;
 	int ret;
 
-	if (mgsm->modem_info_queried) {
-		return 0;
-	}
-
-	ret = modem_cmd_handler_setup_cmds_nolock(&mgsm->context.iface,
-						  &mgsm->context.cmd_handler,
-						  setup_modem_info_cmds,
-						  ARRAY_SIZE(setup_modem_info_cmds),
-						  &mgsm->sem_response,
-						  MGSM_CMD_SETUP_TIMEOUT);
-	LOG_DBG("RETURN VALUE OF CMD_SETUP_NOLOCK: %d", ret);
+	(void)k_sem_init(&mgsm->sem_tx_ready, 0, 1);
+#if defined(CONFIG_MODEM_MGSM_SOCKET_TLS)
+	(void)k_mutex_init(&mgsm->tls_lock);
+#endif
+#if defined(CONFIG_MODEM_MGSM_DNS_OFFLOAD)
+	(void)k_mutex_init(&mgsm->dns_lock);
+	(void)k_sem_init(&mgsm->sem_dns, 0, 1);
+#endif
 
+	ret = modem_socket_init(&mgsm->socket_config, &mgsm->sockets[0],
+				ARRAY_SIZE(mgsm->sockets), 0, true,
+				&offload_socket_fd_op_vtable);
 	if (ret < 0) {
 		return ret;
 	}
 
-	mgsm->modem_info_queried = true;
+	for (i = 0; i < ARRAY_SIZE(mgsm->sockets); i++) {
+		struct mgsm_socket_data *sd = &mgsm->sock_data[i];
+
+		sd->sock = &mgsm->sockets[i];
+		(void)k_sem_init(&sd->sem_open, 0, 1);
+		k_work_init_delayable(&sd->window_work, mgsm_sock_window_work);
+#if defined(CONFIG_MGSM_MODEM_SOCKET_RX_CACHE)
+		k_work_init(&sd->fill_work, mgsm_sock_fill_work);
+#endif
+		mgsm->sockets[i].data = sd;
+	}
 
 	return 0;
 }
 
-static int mgsm_setup_mccmno(struct mgsm_modem *mgsm)
+/* Activates the PDP context used by the sockets */
+static int mgsm_offload_activate(struct mgsm_modem *mgsm)
 {
-	int ret = 0;
-	LOG_INF("inside mgsm_setup_mcmno");
-	ret = modem_cmd_send_nolock(&mgsm->context.iface,
-						    &mgsm->context.cmd_handler,
-						    NULL, 0, "AT+CFUN=1",
-						    &mgsm->sem_response,
-						    MGSM_CMD_AT_TIMEOUT);
+	int ret;
+
+	ret = modem_cmd_send_nolock(&mgsm->context.iface, &mgsm->context.cmd_handler,
+				    NULL, 0U,
+				    "AT+QICSGP=1,1,\"" CONFIG_MODEM_MGSM_APN "\"",
+				    &mgsm->sem_response, MGSM_CMD_AT_TIMEOUT);
 	if (ret < 0) {
-		LOG_ERR("AT+CFUN ret:%d", ret);
+		return ret;
 	}
 
-	// ret = modem_cmd_send_nolock(&mgsm->context.iface,
-	// 					    &mgsm->context.cmd_handler,
-	// 					    NULL, 0, "AT+CFUN=1",
-	// 					    &mgsm->sem_response,
-	// 					    MGSM_CMD_AT_TIMEOUT);
-	// if (ret < 0) {
-	// 	LOG_ERR("AT+CFUN ret:%d", ret);
-	// }
+	/* The context may still be active from before a restart */
+	(void)modem_cmd_send_nolock(&mgsm->context.iface, &mgsm->context.cmd_handler,
+				    NULL, 0U, "AT+QIDEACT=1", &mgsm->sem_response,
+				    MGSM_PDP_ACT_TIMEOUT);
 
-	if (CONFIG_MODEM_MGSM_MANUAL_MCCMNO[0] != '\0') {
-		LOG_INF("sends AT+COPS=1,2,2404");
-		/* use manual MCC/MNO entry */
-		ret = modem_cmd_send_nolock(&mgsm->context.iface,
-					    &mgsm->context.cmd_handler,
-					    NULL, 0,
-					    "AT+COPS=1,2,\""
-					    CONFIG_MODEM_MGSM_MANUAL_MCCMNO
-					    "\"",
-					    &mgsm->sem_response,
-					    MGSM_CMD_AT_TIMEOUT);
-	} else {
+	ret = modem_cmd_send_nolock(&mgsm->context.iface, &mgsm->context.cmd_handler,
+				    NULL, 0U, "AT+QIACT=1", &mgsm->sem_response,
+				    MGSM_PDP_ACT_TIMEOUT);
+	if (ret < 0) {
+		return ret;
+	}
 
-/* First AT+COPS? is sent to check if automatic selection for operator
- * is already enabled, if yes we do not send the command AT+COPS= 0,0.
- */
-		LOG_INF("sends AT+COPS?");
-		ret = modem_cmd_send_nolock(&mgsm->context.iface,
-					    &mgsm->context.cmd_handler,
-					    &read_cops_cmd,
-					    1, "AT+COPS?",
-					    &mgsm->sem_response,
-					    MGSM_CMD_SETUP_TIMEOUT);
+	net_if_carrier_on(mgsm->iface);
 
-		if (ret < 0) {
-			return ret;
-		}
+	return 0;
+}
 
-		if (!mgsm->context.is_automatic_oper) {
-			/* register operator automatically */
-			ret = modem_cmd_send_nolock(&mgsm->context.iface,
-						    &mgsm->context.cmd_handler,
-						    NULL, 0, "AT+COPS=0,0",
-						    &mgsm->sem_response,
-						    MGSM_CMD_AT_TIMEOUT);
-		}
-	}
+static void mgsm_offload_deactivate(struct mgsm_modem *mgsm)
+{
+	size_t i;
 
-	if (ret < 0) {
-		LOG_ERR("AT+COPS ret:%d", ret);
-	}
+	net_if_carrier_off(mgsm->iface);
 
-	return ret;
-}
+#if defined(CONFIG_MODEM_MGSM_SOCKET_TLS)
+	/* Upload the credentials again after the modem power cycle */
+	(void)k_mutex_lock(&mgsm->tls_lock, K_FOREVER);
+	mgsm->tls_tags_len = 0;
+	mgsm->tls_tags_next = 0;
+	(void)k_mutex_unlock(&mgsm->tls_lock);
+#endif
 
+	/* Sockets stay allocated until closed by the application */
+	for (i = 0; i < ARRAY_SIZE(mgsm->sockets); i++) {
+		if (modem_socket_is_allocated(&mgsm->socket_config, &mgsm->sockets[i])) {
+			mgsm->sock_data[i].opened = false;
+			mgsm_sock_closed(&mgsm->sockets[i]);
+		}
+	}
+}
+#else
 static struct net_if *ppp_net_if(void)
 {
 	return net_if_get_first_by_type(&NET_L2_GET_NAME(PPP));
@@ -735,6 +2549,7 @@ static void set_ppp_carrier_on(struct mgsm_modem *mgsm)
 		}
 	}
 }
+#endif /* CONFIG_MODEM_MGSM_SOCKET_OFFLOAD */
 
 static void query_rssi(struct mgsm_modem *mgsm, bool lock)
 {
@@ -774,7 +2589,7 @@ static void rssi_handler(struct k_work *work)
 	mgsm_ppp_lock(mgsm);
 	query_rssi_lock(mgsm);
 
-#if defined(CONFIG_MODEM_CELL_INFO)
+#if defined(CONFIG_MGSM_MODEM_CELL_INFO)
 	(void)mgsm_query_cellinfo(mgsm);
 #endif
 	(void)mgsm_work_reschedule(&mgsm->rssi_work_handle,
@@ -951,11 +2766,23 @@ attaching:
 				goto unlock;
 			}
 		}
-#if defined(CONFIG_MODEM_CELL_INFO)
+#if defined(CONFIG_MGSM_MODEM_CELL_INFO)
 		(void)mgsm_query_cellinfo(mgsm);
 #endif
 	}
 
+#if defined(CONFIG_MODEM_MGSM_SOCKET_OFFLOAD)
+	LOG_DBG("modem RSSI: %d, %s", mgsm->minfo.mdm_rssi, "activate PDP context");
+
+	ret = mgsm_offload_activate(mgsm);
+	if (ret < 0) {
+		LOG_DBG("%s returned %d, %s", "PDP activation", ret, "retrying...");
+		(void)mgsm_work_reschedule(&mgsm->mgsm_configure_work, MGSM_RETRY_DELAY);
+		goto unlock;
+	}
+
+	mgsm->state = MGSM_PPP_SETUP_DONE;
+#else
 	LOG_DBG("modem RSSI: %d, %s", mgsm->minfo.mdm_rssi, "enable PPP");
 
 	ret = modem_cmd_handler_setup_cmds_nolock(&mgsm->context.iface,
@@ -972,6 +2799,7 @@ attaching:
 
 	mgsm->state = MGSM_PPP_SETUP_DONE;
 	set_ppp_carrier_on(mgsm);
+#endif
 	LOG_INF("set_ppp_carrie4r one");
 	if (IS_ENABLED(CONFIG_GSM_MUX)) {
 		/* Re-use the original iface for AT channel */
@@ -1207,6 +3035,146 @@ unlock:
 	mgsm_ppp_unlock(mgsm);
 }
 
+#if defined(CONFIG_MODEM_MGSM_BAUD_ESCALATION)
+static int mgsm_baud_check(struct mgsm_modem *mgsm)
+{
+	int ret = -EIO;
+	int i;
+
+	for (i = 0; i < MGSM_BAUD_CHECK_TRIES && ret < 0; i++) {
+		ret = modem_cmd_send_nolock(&mgsm->context.iface,
+					    &mgsm->context.cmd_handler,
+					    &response_cmds[0],
+					    ARRAY_SIZE(response_cmds),
+					    "AT", &mgsm->sem_response,
+					    MGSM_BAUD_CHECK_TIMEOUT);
+	}
+
+	return ret;
+}
+
+/* Follow the modem to a new rate once it has answered the switch command.
+ * The UART is only reconfigured after our last byte is on the line; the
+ * settle time is for the modem, which changes its rate after the answer.
+ */
+static int mgsm_baud_follow(struct mgsm_modem *mgsm, struct uart_config *cfg,
+			    uint32_t rate)
+{
+	int ret;
+
+	ret = modem_iface_uart_tx_wait(&mgsm->context.iface,
+				       MGSM_BAUD_CHECK_TIMEOUT);
+	if (ret < 0) {
+		LOG_WRN("UART TX not drained before the rate change: %d", ret);
+		return ret;
+	}
+
+	k_sleep(K_MSEC(MGSM_BAUD_SETTLE_MSEC));
+
+	cfg->baudrate = rate;
+
+	return uart_configure(DEVICE_DT_GET(MGSM_UART_NODE), cfg);
+}
+
+static int mgsm_baud_switch(struct mgsm_modem *mgsm, struct uart_config *cfg,
+			    uint32_t rate)
+{
+	const struct device *uart = DEVICE_DT_GET(MGSM_UART_NODE);
+	char cmd[sizeof(CONFIG_MODEM_MGSM_BAUD_CMD) + 10];
+	uint32_t prev = cfg->baudrate;
+	int ret;
+
+	snprintk(cmd, sizeof(cmd), "%s%u", CONFIG_MODEM_MGSM_BAUD_CMD, rate);
+	ret = modem_cmd_send_nolock(&mgsm->context.iface,
+				    &mgsm->context.cmd_handler,
+				    &response_cmds[0],
+				    ARRAY_SIZE(response_cmds),
+				    cmd, &mgsm->sem_response,
+				    MGSM_CMD_AT_TIMEOUT);
+	if (ret < 0) {
+		LOG_DBG("%s failed: %d", cmd, ret);
+		return ret;
+	}
+
+	/* The modem answers at the old rate, then switches */
+	ret = mgsm_baud_follow(mgsm, cfg, rate);
+	if (ret == 0) {
+		ret = mgsm_baud_check(mgsm);
+		if (ret == 0) {
+			return 0;
+		}
+
+		/* The modem may still understand us, ask it to go back */
+		snprintk(cmd, sizeof(cmd), "%s%u", CONFIG_MODEM_MGSM_BAUD_CMD, prev);
+		(void)modem_cmd_send_nolock(&mgsm->context.iface,
+					    &mgsm->context.cmd_handler,
+					    &response_cmds[0],
+					    ARRAY_SIZE(response_cmds),
+					    cmd, &mgsm->sem_response,
+					    MGSM_BAUD_CHECK_TIMEOUT);
+		(void)mgsm_baud_follow(mgsm, cfg, prev);
+	}
+
+	cfg->baudrate = prev;
+	(void)uart_configure(uart, cfg);
+
+	if (mgsm_baud_check(mgsm) < 0) {
+		LOG_ERR("Modem lost after trying %u baud", rate);
+	}
+
+	return -EIO;
+}
+
+static void mgsm_baud_escalate(struct mgsm_modem *mgsm)
+{
+	const char *rates = CONFIG_MODEM_MGSM_BAUD_RATES;
+	struct uart_config cfg;
+	uint32_t rate;
+	char *end;
+
+	if (uart_config_get(DEVICE_DT_GET(MGSM_UART_NODE), &cfg) < 0) {
+		LOG_WRN("UART configuration not available");
+		return;
+	}
+
+	while (*rates != '\0') {
+		rate = strtoul(rates, &end, 10);
+		if (end == rates) {
+			LOG_ERR("Invalid baud rate list at \"%s\"", rates);
+			return;
+		}
+
+		rates = (*end == ',') ? end + 1 : end;
+
+		if (rate <= cfg.baudrate) {
+			continue;
+		}
+
+		if (mgsm_baud_switch(mgsm, &cfg, rate) == 0) {
+			LOG_INF("UART switched to %u baud", rate);
+			return;
+		}
+
+		LOG_WRN("%u baud failed, staying at %u", rate, cfg.baudrate);
+	}
+}
+
+static void mgsm_baud_restore(struct mgsm_modem *mgsm)
+{
+	const struct device *uart = DEVICE_DT_GET(MGSM_UART_NODE);
+	struct uart_config cfg;
+
+	if (mgsm->boot_baudrate == 0) {
+		return;
+	}
+
+	if (uart_config_get(uart, &cfg) == 0 && cfg.baudrate != mgsm->boot_baudrate) {
+		cfg.baudrate = mgsm->boot_baudrate;
+		(void)uart_configure(uart, &cfg);
+	}
+}
+#endif /* CONFIG_MODEM_MGSM_BAUD_ESCALATION */
+
 static void mgsm_configure(struct k_work *work)
 {
 	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
@@ -1245,6 +3213,11 @@ wait_at:
 	LOG_INF("go to at_rdy");
 	mgsm->state = MGSM_PPP_AT_RDY;
 
+#if defined(CONFIG_MODEM_MGSM_BAUD_ESCALATION)
+	/* Best effort, the modem keeps working at the current rate */
+	mgsm_baud_escalate(mgsm);
+#endif
+
 	if (IS_ENABLED(CONFIG_GSM_MUX)) {
 		if (mux_enable(mgsm) == 0) {
 			LOG_DBG("mgsm muxing %s", "enabled");
@@ -1280,8 +3253,13 @@ void mgsm_ppp_start(const struct device *dev)
 
 	mgsm->state = MGSM_PPP_START;
 
+#if defined(CONFIG_MODEM_MGSM_SIM)
+	/* The simulated modem has no UART to re-init */
+	ret = 0;
+#else
 	/* Re-init underlying UART comms */
 	ret = modem_iface_uart_init_dev(&mgsm->context.iface, DEVICE_DT_GET(MGSM_UART_NODE));
+#endif
 	if (ret < 0) {
 		LOG_ERR("modem_iface_uart_init returned %d", ret);
 		mgsm->state = MGSM_PPP_STATE_ERROR;
@@ -1313,11 +3291,16 @@ void mgsm_ppp_stop(const struct device *dev)
 
 	mgsm_ppp_lock(mgsm);
 
+#if defined(CONFIG_MODEM_MGSM_SOCKET_OFFLOAD)
+	ARG_UNUSED(iface);
+	mgsm_offload_deactivate(mgsm);
+#else
 	/* wait for the interface to be properly down */
 	if (net_if_is_up(iface)) {
 		(void)(net_if_l2(iface)->enable(iface, false));
 		(void)k_sem_take(&mgsm->sem_if_down, K_FOREVER);
 	}
+#endif
 
 	if (IS_ENABLED(CONFIG_GSM_MUX)) {
 		if (mgsm->ppp_dev != NULL) {
@@ -1332,6 +3315,11 @@ void mgsm_ppp_stop(const struct device *dev)
 
 	if (mgsm->modem_off_cb != NULL) {
 		mgsm->modem_off_cb(mgsm->dev, mgsm->user_data);
+
+#if defined(CONFIG_MODEM_MGSM_BAUD_ESCALATION)
+		/* The modem comes back up at its default rate */
+		mgsm_baud_restore(mgsm);
+#endif
 	}
 
 	mgsm->state = MGSM_PPP_STOP;
@@ -1546,8 +3534,13 @@ static int mgsm_init(const struct device *dev)
 		.user_data = NULL,
 		.response_cmds = response_cmds,
 		.response_cmds_len = ARRAY_SIZE(response_cmds),
+#if defined(CONFIG_MODEM_MGSM_SOCKET_OFFLOAD)
+		.unsol_cmds = unsol_cmds,
+		.unsol_cmds_len = ARRAY_SIZE(unsol_cmds),
+#else
 		.unsol_cmds = NULL,
 		.unsol_cmds_len = 0,
+#endif
 	};
 
 	(void)k_sem_init(&mgsm->sem_response, 0, 1);
@@ -1560,33 +3553,67 @@ static int mgsm_init(const struct device *dev)
 		return ret;
 	}
 
-#if defined(CONFIG_MODEM_SHELL)
+#if defined(CONFIG_MGSM_MODEM_SHELL)
 	/* modem information storage */
 	mgsm->context.data_manufacturer = mgsm->minfo.mdm_manufacturer;
 	mgsm->context.data_model = mgsm->minfo.mdm_model;
 	mgsm->context.data_revision = mgsm->minfo.mdm_revision;
 	mgsm->context.data_imei = mgsm->minfo.mdm_imei;
-#if defined(CONFIG_MODEM_SIM_NUMBERS)
+#if defined(CONFIG_MGSM_MODEM_SIM_NUMBERS)
 	mgsm->context.data_imsi = mgsm->minfo.mdm_imsi;
 	// mgsm->context.data_iccid = mgsm->minfo.mdm_iccid;
-#endif	/* CONFIG_MODEM_SIM_NUMBERS */
+#endif	/* CONFIG_MGSM_MODEM_SIM_NUMBERS */
 	mgsm->context.data_rssi = &mgsm->minfo.mdm_rssi;
-#endif	/* CONFIG_MODEM_SHELL */
+#endif	/* CONFIG_MGSM_MODEM_SHELL */
 
 	mgsm->context.is_automatic_oper = false;
 
 	const struct modem_iface_uart_config uart_config = {
 		.rx_rb_buf = &mgsm->mgsm_rx_rb_buf[0],
 		.rx_rb_buf_len = sizeof(mgsm->mgsm_rx_rb_buf),
+#if CONFIG_MODEM_MGSM_TX_BUFFER_SIZE > 0
+		.tx_rb_buf = &mgsm->mgsm_tx_rb_buf[0],
+		.tx_rb_buf_len = sizeof(mgsm->mgsm_tx_rb_buf),
+#endif
 		.hw_flow_control = DT_PROP(MGSM_UART_NODE, hw_flow_control),
 		.dev = DEVICE_DT_GET(MGSM_UART_NODE),
 	};
 
+#if defined(CONFIG_MODEM_MGSM_SIM)
+	const struct modem_iface_sim_config sim_config = {
+		.rules = mgsm_sim_rules,
+		.rules_len = ARRAY_SIZE(mgsm_sim_rules),
+#if defined(CONFIG_MODEM_MGSM_SOCKET_OFFLOAD)
+		.urcs = mgsm_sim_urcs,
+		.urcs_len = ARRAY_SIZE(mgsm_sim_urcs),
+#endif
+		.no_match = "\r\nERROR\r\n",
+		.latency_ms = CONFIG_MODEM_MGSM_SIM_LATENCY,
+		.baudrate = CONFIG_MODEM_MGSM_SIM_BAUDRATE,
+		.rx_rb_buf = &mgsm->mgsm_rx_rb_buf[0],
+		.rx_rb_buf_len = sizeof(mgsm->mgsm_rx_rb_buf),
+		.tx_rb_buf = &mgsm->sim_tx_rb_buf[0],
+		.tx_rb_buf_len = sizeof(mgsm->sim_tx_rb_buf),
+	};
+
+	ARG_UNUSED(uart_config);
+	ret = modem_iface_sim_init(&mgsm->context.iface, &mgsm->sim_data, &sim_config);
+#else
 	ret = modem_iface_uart_init(&mgsm->context.iface, &mgsm->mgsm_data, &uart_config);
+#endif
 	if (ret < 0) {
 		LOG_DBG("iface uart error %d", ret);
 		return ret;
 	}
+
+#if defined(CONFIG_MODEM_MGSM_BAUD_ESCALATION)
+	{
+		struct uart_config cfg;
+
+		ret = uart_config_get(uart_config.dev, &cfg);
+		mgsm->boot_baudrate = (ret == 0) ? cfg.baudrate : 0;
+	}
+#endif
 	LOG_INF("iface uart is enabled");
 
 	ret = modem_context_register(&mgsm->context);
@@ -1619,11 +3646,20 @@ static int mgsm_init(const struct device *dev)
 		k_work_init_delayable(&mgsm->rssi_work_handle, rssi_handler);
 	}
 
+#if defined(CONFIG_MODEM_MGSM_SOCKET_OFFLOAD)
+	/* mgsm->iface is set by the offloaded interface init */
+	ret = mgsm_offload_init(mgsm);
+	if (ret < 0) {
+		LOG_ERR("socket init error %d", ret);
+		return ret;
+	}
+#else
 	mgsm->iface = ppp_net_if();
 	if (mgsm->iface == NULL) {
 		LOG_ERR("Couldn't find ppp net_if!");
 		return -ENODEV;
 	}
+#endif
 
 	net_mgmt_init_event_callback(&mgsm->mgsm_mgmt_cb, mgsm_mgmt_event_handler,
 				     NET_EVENT_IF_DOWN);
@@ -1638,5 +3674,11 @@ static int mgsm_init(const struct device *dev)
 
 // DEVICE_DT_DEFINE(DT_DRV_INST(0), mgsm_init, NULL, &mgsm, NULL,
 // 		 POST_KERNEL, CONFIG_MODEM_mgsm_INIT_PRIORITY, NULL);
+#if defined(CONFIG_MODEM_MGSM_SOCKET_OFFLOAD)
+NET_DEVICE_DT_OFFLOAD_DEFINE(DT_INST(0, quectel_bg95_ppp), mgsm_init, NULL, &mgsm, NULL,
+			     CONFIG_MODEM_MGSM_INIT_PRIORITY, &mgsm_offload_api,
+			     MGSM_SOCKET_MAX_DATA_LEN);
+#else
 DEVICE_DT_DEFINE(DT_INST(0, quectel_bg95_ppp), mgsm_init, NULL, &mgsm, NULL,
-		 POST_KERNEL, CONFIG_MODEM_MGSM_INIT_PRIORITY, NULL);
\ No newline at end of file
+		 POST_KERNEL, CONFIG_MODEM_MGSM_INIT_PRIORITY, NULL);
+#endif
\ No newline at end of file
@@ -22,30 +22,10 @@ LOG_MODULE_REGISTER(mdm_receiver, CONFIG_MODEM_LOG_LEVEL);
 
 #include "modem_receiver.h"
 
-#define MAX_MDM_CTX	CONFIG_MODEM_RECEIVER_MAX_CONTEXTS
-#define MAX_READ_SIZE	128
+#define MAX_MDM_CTX	CONFIG_MGSM_MODEM_RECEIVER_MAX_CONTEXTS
 
 static struct mdm_receiver_context *contexts[MAX_MDM_CTX];
-
-/**
- * @brief  Finds receiver context which manages provided device.
- *
- * @param  *dev: device used by the receiver context.
- *
- * @retval Receiver context or NULL.
- */
-static struct mdm_receiver_context *context_from_dev(const struct device *dev)
-{
-	int i;
-
-	for (i = 0; i < MAX_MDM_CTX; i++) {
-		if (contexts[i] && contexts[i]->uart_dev == dev) {
-			return contexts[i];
-		}
-	}
-
-	return NULL;
-}
+static struct k_spinlock contexts_lock;
 
 /**
  * @brief  Persists receiver context if there is a free place.
@@ -59,16 +39,23 @@ static struct mdm_receiver_context *context_from_dev(const struct device *dev)
  */
 static int mdm_receiver_get(struct mdm_receiver_context *ctx)
 {
+	k_spinlock_key_t key;
+	int ret = -ENOMEM;
 	int i;
 
+	key = k_spin_lock(&contexts_lock);
+
 	for (i = 0; i < MAX_MDM_CTX; i++) {
 		if (!contexts[i]) {
 			contexts[i] = ctx;
-			return 0;
+			ret = 0;
+			break;
 		}
 	}
 
-	return -ENOMEM;
+	k_spin_unlock(&contexts_lock, key);
+
+	return ret;
 }
 
 /**
@@ -92,26 +79,57 @@ static void mdm_receiver_flush(struct mdm_receiver_context *ctx)
 	}
 }
 
+#if CONFIG_MGSM_MODEM_RECEIVER_TX_BUFFER_SIZE > 0
+/**
+ * @brief  Moves queued data from the TX ring buffer to the UART FIFO.
+ *
+ * @note   Disables the TX interrupt once the ring buffer is empty.
+ *
+ * @param  *ctx: receiver context.
+ *
+ * @retval None.
+ */
+static void mdm_receiver_tx_isr(struct mdm_receiver_context *ctx)
+{
+	uint8_t *src;
+	uint32_t len;
+	int sent;
+
+	len = ring_buf_get_claim(&ctx->tx_rb, &src, UINT32_MAX);
+	if (len == 0) {
+		uart_irq_tx_disable(ctx->uart_dev);
+		return;
+	}
+
+	sent = uart_fifo_fill(ctx->uart_dev, src, len);
+	ring_buf_get_finish(&ctx->tx_rb, MAX(sent, 0));
+
+	if (sent > 0) {
+		k_sem_give(&ctx->tx_space_sem);
+	}
+}
+#endif
+
 /**
  * @brief  Receiver UART interrupt handler.
  *
- * @note   Fills contexts ring buffer with received data.
+ * @note   Reads received data straight into the contexts ring buffer.
  *         When ring buffer is full the data is discarded.
+ *         Feeds the UART with data from the TX ring buffer.
  *
  * @param  *uart_dev: uart device.
+ * @param  *user_data: receiver context.
  *
  * @retval None.
  */
 static void mdm_receiver_isr(const struct device *uart_dev, void *user_data)
 {
-	struct mdm_receiver_context *ctx;
-	int rx, ret;
-	static uint8_t read_buf[MAX_READ_SIZE];
-
-	ARG_UNUSED(user_data);
+	struct mdm_receiver_context *ctx = user_data;
+	uint32_t total_size = 0;
+	uint32_t room;
+	uint8_t *dst;
+	int rx;
 
-	/* lookup the device */
-	ctx = context_from_dev(uart_dev);
 	if (!ctx) {
 		return;
 	}
@@ -119,20 +137,30 @@ static void mdm_receiver_isr(const struct device *uart_dev, void *user_data)
 	/* get all of the data off UART as fast as we can */
 	while (uart_irq_update(ctx->uart_dev) &&
 	       uart_irq_rx_ready(ctx->uart_dev)) {
-		rx = uart_fifo_read(ctx->uart_dev, read_buf, sizeof(read_buf));
+		room = ring_buf_put_claim(&ctx->rx_rb, &dst, UINT32_MAX);
+		if (room == 0) {
+			LOG_ERR("Rx buffer doesn't have enough space. "
+				"Bytes received: %u", total_size);
+			mdm_receiver_flush(ctx);
+			break;
+		}
+
+		rx = uart_fifo_read(ctx->uart_dev, dst, room);
+		(void)ring_buf_put_finish(&ctx->rx_rb, MAX(rx, 0));
 		if (rx > 0) {
-			ret = ring_buf_put(&ctx->rx_rb, read_buf, rx);
-			if (ret != rx) {
-				LOG_ERR("Rx buffer doesn't have enough space. "
-						"Bytes pending: %d, written: %d",
-						rx, ret);
-				mdm_receiver_flush(ctx);
-				k_sem_give(&ctx->rx_sem);
-				break;
-			}
-			k_sem_give(&ctx->rx_sem);
+			total_size += rx;
 		}
 	}
+
+	if (total_size > 0) {
+		k_sem_give(&ctx->rx_sem);
+	}
+
+#if CONFIG_MGSM_MODEM_RECEIVER_TX_BUFFER_SIZE > 0
+	if (uart_irq_tx_ready(ctx->uart_dev)) {
+		mdm_receiver_tx_isr(ctx);
+	}
+#endif
 }
 
 /**
@@ -149,7 +177,7 @@ static void mdm_receiver_setup(struct mdm_receiver_context *ctx)
 	uart_irq_rx_disable(ctx->uart_dev);
 	uart_irq_tx_disable(ctx->uart_dev);
 	mdm_receiver_flush(ctx);
-	uart_irq_callback_set(ctx->uart_dev, mdm_receiver_isr);
+	uart_irq_callback_user_data_set(ctx->uart_dev, mdm_receiver_isr, ctx);
 	uart_irq_rx_enable(ctx->uart_dev);
 }
 
@@ -189,9 +217,25 @@ int mdm_receiver_send(struct mdm_receiver_context *ctx,
 		return 0;
 	}
 
+#if CONFIG_MGSM_MODEM_RECEIVER_TX_BUFFER_SIZE > 0
+	/* The ISR sends the data, we only have to wait if it does not fit */
+	while (size > 0) {
+		uint32_t written = ring_buf_put(&ctx->tx_rb, buf, size);
+
+		buf += written;
+		size -= written;
+
+		uart_irq_tx_enable(ctx->uart_dev);
+
+		if (size > 0) {
+			k_sem_take(&ctx->tx_space_sem, K_FOREVER);
+		}
+	}
+#else
 	do {
 		uart_poll_out(ctx->uart_dev, *buf++);
 	} while (--size);
+#endif
 
 	return 0;
 }
@@ -234,6 +278,10 @@ int mdm_receiver_register(struct mdm_receiver_context *ctx,
 	ctx->uart_dev = uart_dev;
 	ring_buf_init(&ctx->rx_rb, size, buf);
 	k_sem_init(&ctx->rx_sem, 0, 1);
+#if CONFIG_MGSM_MODEM_RECEIVER_TX_BUFFER_SIZE > 0
+	ring_buf_init(&ctx->tx_rb, sizeof(ctx->tx_buf), ctx->tx_buf);
+	k_sem_init(&ctx->tx_space_sem, 0, 1);
+#endif
 
 	ret = mdm_receiver_get(ctx);
 	if (ret < 0) {
@@ -28,11 +28,18 @@ struct mdm_receiver_context {
 	struct ring_buf rx_rb;
 	struct k_sem rx_sem;
 
+#if CONFIG_MGSM_MODEM_RECEIVER_TX_BUFFER_SIZE > 0
+	/* tx data, drained from the tx ready interrupt */
+	struct ring_buf tx_rb;
+	struct k_sem tx_space_sem;
+	uint8_t tx_buf[CONFIG_MGSM_MODEM_RECEIVER_TX_BUFFER_SIZE];
+#endif
+
 	/* modem data */
 	char *data_manufacturer;
 	char *data_model;
 	char *data_revision;
-#if defined(CONFIG_MODEM_SIM_NUMBERS)
+#if defined(CONFIG_MGSM_MODEM_SIM_NUMBERS)
 	char *data_imei;
 	char *data_imsi;
 #endif
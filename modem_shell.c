@@ -21,28 +21,44 @@
 
 #include <zephyr/sys/printk.h>
 
+#if defined(CONFIG_GSM_MUX)
+#include "gsm_mux.h"
+#endif
+#if defined(CONFIG_GSM_MUX_BENCHMARK)
+#include "gsm_mux_bench.h"
+#endif
+#if defined(CONFIG_MGSM_MODEM_SOCKET)
+#include "modem_socket.h"
+#endif
+#if defined(CONFIG_MGSM_MODEM_SOCKET_BENCHMARK)
+#include "modem_socket_bench.h"
+#endif
+
 struct modem_shell_user_data {
 	const struct shell *sh;
 	void *user_data;
 };
 
-#if defined(CONFIG_MODEM_CONTEXT)
+#if defined(CONFIG_MGSM_MODEM_CONTEXT)
 #include "modem_context.h"
+#if defined(CONFIG_MGSM_MODEM_IFACE_UART)
+#include "modem_iface_uart.h"
+#endif
 #define ms_context		modem_context
-#define ms_max_context		CONFIG_MODEM_CONTEXT_MAX_NUM
+#define ms_max_context		CONFIG_MGSM_MODEM_CONTEXT_MAX_NUM
 #define ms_send(ctx_, buf_, size_) \
 			(ctx_->iface.write(&ctx_->iface, buf_, size_))
 #define ms_context_from_id	modem_context_from_id
 #define UART_DEV_NAME(ctx)	(ctx->iface.dev->name)
-#elif defined(CONFIG_MODEM_RECEIVER)
+#elif defined(CONFIG_MGSM_MODEM_RECEIVER)
 #include "modem_receiver.h"
 #define ms_context		mdm_receiver_context
-#define ms_max_context		CONFIG_MODEM_RECEIVER_MAX_CONTEXTS
+#define ms_max_context		CONFIG_MGSM_MODEM_RECEIVER_MAX_CONTEXTS
 #define ms_send			mdm_receiver_send
 #define ms_context_from_id	mdm_receiver_context_from_id
 #define UART_DEV_NAME(ctx_)	(ctx_->uart_dev->name)
 #else
-#error "MODEM_CONTEXT or MODEM_RECEIVER need to be enabled"
+#error "MGSM_MODEM_CONTEXT or MGSM_MODEM_RECEIVER need to be enabled"
 #endif
 
 static int cmd_modem_list(const struct shell *sh, size_t argc,
@@ -63,11 +79,11 @@ static int cmd_modem_list(const struct shell *sh, size_t argc,
 				"\tModel:        %s\n"
 				"\tRevision:     %s\n"
 				"\tIMEI:         %s\n"
-#if defined(CONFIG_MODEM_SIM_NUMBERS)
+#if defined(CONFIG_MGSM_MODEM_SIM_NUMBERS)
 				"\tIMSI:         %s\n"
 				"\tICCID:        %s\n"
 #endif
-#if defined(CONFIG_MODEM_CELL_INFO)
+#if defined(CONFIG_MGSM_MODEM_CELL_INFO)
 				"\tOperator:     %d\n"
 				"\tLAC:          %d\n"
 				"\tCellId:       %d\n"
@@ -80,11 +96,11 @@ static int cmd_modem_list(const struct shell *sh, size_t argc,
 			       mdm_ctx->data_model,
 			       mdm_ctx->data_revision,
 			       mdm_ctx->data_imei,
-#if defined(CONFIG_MODEM_SIM_NUMBERS)
+#if defined(CONFIG_MGSM_MODEM_SIM_NUMBERS)
 			       mdm_ctx->data_imsi,
 			       mdm_ctx->data_iccid,
 #endif
-#if defined(CONFIG_MODEM_CELL_INFO)
+#if defined(CONFIG_MGSM_MODEM_CELL_INFO)
 			       mdm_ctx->data_operator,
 			       mdm_ctx->data_lac,
 			       mdm_ctx->data_cellid,
@@ -159,7 +175,7 @@ static void uart_mux_cb(const struct device *uart, const struct device *dev,
 			int dlci_address, void *user_data)
 {
 	struct modem_shell_user_data *data = user_data;
-	const struct shell *sh = data->shell;
+	const struct shell *sh = data->sh;
 	int *count = data->user_data;
 	const char *ch = "?";
 
@@ -227,6 +243,25 @@ static int cmd_modem_info(const struct shell *sh, size_t argc, char *argv[])
 		      mdm_ctx->data_imei,
 		      mdm_ctx->data_rssi ? *mdm_ctx->data_rssi : 0);
 
+#if defined(CONFIG_MGSM_MODEM_IFACE_UART)
+	struct modem_iface_uart_stats uart_stats;
+
+	if (modem_iface_uart_stats_get(&mdm_ctx->iface, &uart_stats) == 0) {
+		shell_fprintf(sh, SHELL_NORMAL,
+			      "RX paused        : %u times, %u ms\n"
+			      "RX bytes         : %llu\n"
+			      "RX wakeups       : %u (%u on idle line)\n"
+			      "RX wake delay    : %u us avg, %u us max\n",
+			      uart_stats.rx_pause_count,
+			      uart_stats.rx_paused_ms,
+			      (unsigned long long)uart_stats.rx_bytes,
+			      uart_stats.rx_wakeups,
+			      uart_stats.rx_idle_wakeups,
+			      uart_stats.rx_wake_delay_us_avg,
+			      uart_stats.rx_wake_delay_us_max);
+	}
+#endif
+
 	shell_fprintf(sh, SHELL_NORMAL,
 		      "GSM 07.10 muxing : %s\n",
 		      IS_ENABLED(CONFIG_GSM_MUX) ? "enabled" : "disabled");
@@ -235,7 +270,7 @@ static int cmd_modem_info(const struct shell *sh, size_t argc, char *argv[])
 	struct modem_shell_user_data user_data;
 	int count = 0;
 
-	user_data.shell = sh;
+	user_data.sh = sh;
 	user_data.user_data = &count;
 
 	uart_mux_foreach(uart_mux_cb, &user_data);
@@ -244,11 +279,352 @@ static int cmd_modem_info(const struct shell *sh, size_t argc, char *argv[])
 	return 0;
 }
 
+#if defined(CONFIG_GSM_MUX) || defined(CONFIG_MGSM_MODEM_SOCKET_BENCHMARK)
+static int parse_opt_u32(const struct shell *sh, size_t argc, char *argv[],
+			 int arg, uint32_t *value)
+{
+	char *endptr;
+
+	if (arg >= argc) {
+		return 0;
+	}
+
+	*value = (uint32_t)strtoul(argv[arg], &endptr, 10);
+	if (*endptr != '\0') {
+		shell_fprintf(sh, SHELL_ERROR, "Invalid value \"%s\"\n",
+			      argv[arg]);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+#endif
+
+#if defined(CONFIG_MGSM_MODEM_SOCKET)
+static void modem_sockets_cb(struct modem_socket_config *cfg,
+			     struct modem_socket *sock, void *user_data)
+{
+	struct modem_shell_user_data *data = user_data;
+	const struct shell *sh = data->sh;
+	struct modem_socket_rx_cache_stats cache;
+	struct modem_socket_wake_latency wake;
+
+	ARG_UNUSED(cfg);
+
+	shell_fprintf(sh, SHELL_NORMAL, "%d\t%d\t%s\t",
+		      sock->sock_fd, sock->id,
+		      sock->type == SOCK_STREAM ? "stream" : "dgram");
+
+	if (modem_socket_rx_cache_stats_get(sock, &cache) == 0) {
+		shell_fprintf(sh, SHELL_NORMAL, "%u/%u/%u/%u\t\t\t",
+			      cache.hits, cache.misses, cache.fills,
+			      cache.used);
+	} else {
+		shell_fprintf(sh, SHELL_NORMAL, "-\t\t\t\t");
+	}
+
+	if (modem_socket_wake_latency_get(sock, &wake) == 0) {
+		shell_fprintf(sh, SHELL_NORMAL, "%u/%u/%u\n",
+			      wake.count, wake.avg_us, wake.max_us);
+	} else {
+		shell_fprintf(sh, SHELL_NORMAL, "-\n");
+	}
+
+	(*(int *)data->user_data)++;
+}
+
+static int cmd_modem_sockets(const struct shell *sh, size_t argc,
+			     char *argv[])
+{
+	struct modem_shell_user_data user_data;
+	int count = 0;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	user_data.sh = sh;
+	user_data.user_data = &count;
+
+	shell_fprintf(sh, SHELL_NORMAL,
+		      "Fd\tId\tType\tCache hits/misses/fills/bytes\t"
+		      "Wake count/avg us/max us\n");
+
+	modem_socket_foreach(modem_sockets_cb, &user_data);
+
+	if (count == 0) {
+		shell_fprintf(sh, SHELL_NORMAL, "None found.\n");
+	}
+
+	return 0;
+}
+#endif
+
+#if defined(CONFIG_MGSM_MODEM_SOCKET_BENCHMARK)
+static int cmd_modem_sockbench(const struct shell *sh, size_t argc,
+			       char *argv[])
+{
+	struct modem_socket_bench_params params = {
+		.threads = CONFIG_MGSM_MODEM_SOCKET_BENCHMARK_MAX_THREADS,
+		.iterations = 100000,
+		.shared = false,
+		.global_lock = false,
+	};
+	struct modem_socket_bench_result res;
+	uint32_t shared = 0;
+	uint32_t global = 0;
+	int ret;
+
+	/* sockbench [threads] [iterations] [shared] [global] */
+	if (parse_opt_u32(sh, argc, argv, 1, &params.threads) ||
+	    parse_opt_u32(sh, argc, argv, 2, &params.iterations) ||
+	    parse_opt_u32(sh, argc, argv, 3, &shared) ||
+	    parse_opt_u32(sh, argc, argv, 4, &global)) {
+		return -EINVAL;
+	}
+
+	params.shared = shared != 0;
+	params.global_lock = global != 0;
+
+	ret = modem_socket_bench_run(&params, &res);
+	if (ret < 0) {
+		shell_fprintf(sh, SHELL_ERROR, "Benchmark failed (%d)\n", ret);
+		return ret;
+	}
+
+	shell_fprintf(sh, SHELL_NORMAL,
+		      "Threads          : %u, %s\n"
+		      "Locking          : %s\n"
+		      "Duration         : %u ms\n"
+		      "Calls            : %u (%u/s)\n"
+		      "CPU              : %u cycles/call\n"
+		      "Errors           : %u\n",
+		      params.threads,
+		      params.shared ? "shared socket" : "socket per thread",
+		      params.global_lock ? "config wide (baseline)" : "per socket",
+		      res.elapsed_ms,
+		      (uint32_t)res.ops,
+		      (uint32_t)(res.ops * MSEC_PER_SEC / MAX(res.elapsed_ms, 1)),
+		      (uint32_t)(res.ops ? res.cycles / res.ops : 0),
+		      res.errors);
+
+	return 0;
+}
+#endif
+
+#if defined(CONFIG_GSM_MUX)
+static int cmd_modem_mux_bench(const struct shell *sh, size_t argc,
+			       char *argv[])
+{
+#if defined(CONFIG_GSM_MUX_BENCHMARK)
+	struct gsm_mux_bench_params params = {
+		.duration_ms = 5000,
+		.baudrate = 115200,
+		.latency_us = 1000,
+		.ber = 0,
+		.at_interval_ms = 100,
+		.ppp_frame_len = 0,
+		.seed = 1,
+	};
+	static const char * const names[] = { "PPP", "AT" };
+	static struct gsm_mux_bench_result res;
+	uint32_t ppp_len = 0;
+	uint64_t bps;
+	int i, ret;
+
+	/* bench [duration ms] [baudrate] [latency us] [ber 1e-9]
+	 *       [AT interval ms] [PPP frame len]
+	 */
+	if (parse_opt_u32(sh, argc, argv, 1, &params.duration_ms) ||
+	    parse_opt_u32(sh, argc, argv, 2, &params.baudrate) ||
+	    parse_opt_u32(sh, argc, argv, 3, &params.latency_us) ||
+	    parse_opt_u32(sh, argc, argv, 4, &params.ber) ||
+	    parse_opt_u32(sh, argc, argv, 5, &params.at_interval_ms) ||
+	    parse_opt_u32(sh, argc, argv, 6, &ppp_len)) {
+		return -EINVAL;
+	}
+
+	params.ppp_frame_len = ppp_len;
+
+	ret = gsm_mux_bench_run(&params, &res);
+	if (ret < 0) {
+		shell_fprintf(sh, SHELL_ERROR, "Benchmark failed (%d)\n", ret);
+		return ret;
+	}
+
+	bps = res.bytes * MSEC_PER_SEC / MAX(res.elapsed_ms, 1);
+
+	shell_fprintf(sh, SHELL_NORMAL,
+		      "Duration         : %u ms\n"
+		      "Line             : %u bps, %u us, BER %u e-9\n"
+		      "Frames           : %u (%u/s)\n"
+		      "Payload          : %u.%03u MB/s\n"
+		      "CPU              : %u cycles/byte\n"
+		      "Line bytes       : %u (%u dropped, %u bit errors)\n",
+		      res.elapsed_ms,
+		      params.baudrate, params.latency_us, params.ber,
+		      res.frames,
+		      (uint32_t)((uint64_t)res.frames * MSEC_PER_SEC /
+				 MAX(res.elapsed_ms, 1)),
+		      (uint32_t)(bps / 1000000U),
+		      (uint32_t)(bps / 1000U % 1000U),
+		      (uint32_t)(res.bytes ? res.cycles / res.bytes : 0),
+		      (uint32_t)res.line_bytes, res.pipe_drops,
+		      res.bit_errors);
+
+	for (i = 0; i < GSM_MUX_BENCH_CHANNELS; i++) {
+		shell_fprintf(sh, SHELL_NORMAL,
+			      "%-4s sent %u recv %u corrupt %u, latency us "
+			      "p50 %u p90 %u p99 %u max %u\n",
+			      names[i], res.ch[i].sent, res.ch[i].received,
+			      res.ch[i].corrupted,
+			      res.ch[i].latency_us[GSM_MUX_BENCH_P50],
+			      res.ch[i].latency_us[GSM_MUX_BENCH_P90],
+			      res.ch[i].latency_us[GSM_MUX_BENCH_P99],
+			      res.ch[i].latency_us[GSM_MUX_BENCH_MAX]);
+	}
+
+	return 0;
+#else
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	shell_fprintf(sh, SHELL_ERROR, "Benchmark not enabled\n");
+	return -ENOEXEC;
+#endif
+}
+
+static void mux_dlci_stats_cb(struct gsm_dlci *dlci, void *user_data)
+{
+	struct modem_shell_user_data *data = user_data;
+	const struct shell *sh = data->sh;
+	struct gsm_dlci_stats stats;
+
+	if (gsm_dlci_stats_get(dlci, &stats) < 0) {
+		return;
+	}
+
+	shell_fprintf(sh, SHELL_NORMAL,
+		      "%d\t%u/%u\t\t%u/%u\t\t%u\t%u\n",
+		      gsm_dlci_id(dlci),
+		      stats.rx_frames, stats.rx_bytes,
+		      stats.tx_frames, stats.tx_bytes,
+		      stats.retransmissions, stats.refused);
+}
+
+static void mux_stats_cb(struct gsm_mux *mux, void *user_data)
+{
+	struct modem_shell_user_data *data = user_data;
+	const struct shell *sh = data->sh;
+	struct gsm_mux_stats stats;
+	struct gsm_mux_timers timers;
+
+	if (gsm_mux_stats_get(mux, &stats) < 0 ||
+	    gsm_mux_timers_get(mux, &timers) < 0) {
+		return;
+	}
+
+	shell_fprintf(sh, SHELL_NORMAL,
+		      "Mux %p\n"
+		      "RX frames/bytes  : %u/%u\n"
+		      "TX frames/bytes  : %u/%u\n"
+		      "FCS errors       : %u\n"
+		      "Oversize drops   : %u\n"
+		      "Alloc failures   : %u\n"
+		      "Resyncs/skipped  : %u/%u\n"
+		      "T1/T2 resends    : %u/%u\n"
+		      "NSC replies      : %u\n"
+		      "DLCIs refused    : %u\n"
+		      "FCOFF            : %u times, %u ms\n",
+		      mux,
+		      stats.rx_frames, stats.rx_bytes,
+		      stats.tx_frames, stats.tx_bytes,
+		      stats.fcs_errors, stats.oversize_drops,
+		      stats.alloc_failures,
+		      stats.resync_events, stats.resync_discarded,
+		      stats.t1_retransmissions, stats.t2_retransmissions,
+		      stats.nsc_replies, stats.dlci_refused,
+		      stats.fcoff_count, stats.fcoff_ms);
+
+	shell_fprintf(sh, SHELL_NORMAL,
+		      "T1/T2            : %u/%u ms\n"
+		      "T1 SRTT/RTTVAR   : %u/%u ms\n"
+		      "T2 SRTT/RTTVAR   : %u/%u ms\n"
+		      "RTT samples      : %u\n"
+		      "RTT histogram    :",
+		      timers.t1, timers.t2,
+		      timers.t1_srtt, timers.t1_rttvar,
+		      timers.t2_srtt, timers.t2_rttvar,
+		      timers.samples);
+
+	/* Bucket n counts samples below 2^n ms, the last one all above */
+	for (int i = 0; i < GSM_MUX_RTT_HIST_LEN - 1; i++) {
+		shell_fprintf(sh, SHELL_NORMAL, " <%u:%u", 1U << i,
+			      timers.rtt_hist[i]);
+	}
+
+	shell_fprintf(sh, SHELL_NORMAL, " >=%u:%u",
+		      1U << (GSM_MUX_RTT_HIST_LEN - 2),
+		      timers.rtt_hist[GSM_MUX_RTT_HIST_LEN - 1]);
+
+	shell_fprintf(sh, SHELL_NORMAL, "\n");
+
+	shell_fprintf(sh, SHELL_NORMAL,
+		      "\nDLCI\tRX frames/bytes\tTX frames/bytes\tResent\t"
+		      "Refused\n");
+
+	gsm_mux_dlci_foreach(mux, mux_dlci_stats_cb, user_data);
+
+	(*(int *)data->user_data)++;
+}
+
+static int cmd_modem_mux_stats(const struct shell *sh, size_t argc,
+			       char *argv[])
+{
+	struct modem_shell_user_data user_data;
+	int count = 0;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	user_data.sh = sh;
+	user_data.user_data = &count;
+
+	gsm_mux_foreach(mux_stats_cb, &user_data);
+
+	if (count == 0) {
+		shell_fprintf(sh, SHELL_NORMAL, "None found.\n");
+	}
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_mux,
+	SHELL_COND_CMD(CONFIG_GSM_MUX_BENCHMARK, bench, NULL,
+		       "Run a loopback benchmark [duration ms] [baudrate] "
+		       "[latency us] [ber 1e-9] [AT interval ms] "
+		       "[PPP frame len]", cmd_modem_mux_bench),
+	SHELL_CMD(stats, NULL, "Show mux traffic and error statistics",
+		  cmd_modem_mux_stats),
+	SHELL_SUBCMD_SET_END /* Array terminated. */
+);
+#define MODEM_MUX_CMDS (&sub_mux)
+#else
+#define MODEM_MUX_CMDS NULL
+#endif
+
 SHELL_STATIC_SUBCMD_SET_CREATE(sub_modem,
 	SHELL_CMD(info, NULL, "Show information for a modem", cmd_modem_info),
 	SHELL_CMD(list, NULL, "List registered modems", cmd_modem_list),
+	SHELL_COND_CMD(CONFIG_GSM_MUX, mux, MODEM_MUX_CMDS,
+		       "GSM 07.10 mux commands", NULL),
 	SHELL_CMD(send, NULL, "Send an AT <command> to a registered modem "
 			      "receiver", cmd_modem_send),
+	SHELL_COND_CMD(CONFIG_MGSM_MODEM_SOCKET, sockets, NULL,
+		       "Show modem socket statistics", cmd_modem_sockets),
+	SHELL_COND_CMD(CONFIG_MGSM_MODEM_SOCKET_BENCHMARK, sockbench, NULL,
+		       "Run a socket lock contention benchmark [threads] "
+		       "[iterations] [shared 0/1] [global lock 0/1]",
+		       cmd_modem_sockbench),
 	SHELL_SUBCMD_SET_END /* Array terminated. */
 );
 
@@ -15,128 +15,317 @@
 
 #include "modem_socket.h"
 
+/* Configs passed to modem_socket_init(), for modem_socket_foreach() */
+static sys_slist_t modem_socket_configs = SYS_SLIST_STATIC_INIT(&modem_socket_configs);
+
 /*
  * Packet Size Support Functions
  */
 
 uint16_t modem_socket_next_packet_size(struct modem_socket_config *cfg, struct modem_socket *sock)
 {
+	k_spinlock_key_t key;
 	uint16_t total = 0U;
 
-	k_sem_take(&cfg->sem_lock, K_FOREVER);
+	ARG_UNUSED(cfg);
 
-	if (!sock || !sock->packet_count) {
-		goto exit;
+	if (!sock) {
+		return 0U;
 	}
 
-	total = sock->packet_sizes[0];
+	key = k_spin_lock(&sock->lock);
 
-exit:
-	k_sem_give(&cfg->sem_lock);
+	if (sock->packet_count) {
+		total = sock->packet_sizes[sock->packet_head];
+	}
+
+	k_spin_unlock(&sock->lock, key);
 	return total;
 }
 
-static uint16_t modem_socket_packet_get_total(struct modem_socket *sock)
+static void modem_socket_packet_reset(struct modem_socket *sock)
 {
-	int i;
-	uint16_t total = 0U;
+	sock->packet_head = 0U;
+	sock->packet_count = 0U;
+	sock->packet_total = 0U;
+}
 
-	if (!sock || !sock->packet_count) {
-		return 0U;
+/* data ready while there is data in the modem or in the receive cache */
+static bool modem_socket_rx_pending(struct modem_socket *sock)
+{
+	return sock->packet_total > 0U || modem_socket_rx_cache_len(sock) > 0U;
+}
+
+static void modem_socket_data_ready_signal(struct modem_socket *sock)
+{
+	if (modem_socket_rx_pending(sock)) {
+		k_poll_signal_raise(&sock->sig_data_ready, 0);
+	} else {
+		k_poll_signal_reset(&sock->sig_data_ready);
 	}
+}
+
+static void modem_socket_packet_push(struct modem_socket *sock, uint16_t size)
+{
+	int i = sock->packet_head + sock->packet_count;
 
-	for (i = 0; i < sock->packet_count; i++) {
-		total += sock->packet_sizes[i];
+	if (i >= CONFIG_MGSM_MODEM_SOCKET_PACKET_COUNT) {
+		i -= CONFIG_MGSM_MODEM_SOCKET_PACKET_COUNT;
 	}
 
-	return total;
+	sock->packet_sizes[i] = size;
+	sock->packet_count++;
+	sock->packet_total += size;
 }
 
 static int modem_socket_packet_drop_first(struct modem_socket *sock)
 {
-	int i;
-
 	if (!sock || !sock->packet_count) {
 		return -EINVAL;
 	}
 
+	sock->packet_total -= sock->packet_sizes[sock->packet_head];
+	sock->packet_sizes[sock->packet_head] = 0U;
 	sock->packet_count--;
-	for (i = 0; i < sock->packet_count; i++) {
-		sock->packet_sizes[i] = sock->packet_sizes[i + 1];
+
+	if (++sock->packet_head == CONFIG_MGSM_MODEM_SOCKET_PACKET_COUNT) {
+		sock->packet_head = 0U;
 	}
 
-	sock->packet_sizes[sock->packet_count] = 0U;
 	return 0;
 }
 
+/* remove len bytes read from the front of the packets */
+static void modem_socket_packet_consume(struct modem_socket *sock, uint32_t len)
+{
+	uint16_t *first;
+
+	while (len > 0 && sock->packet_count > 0) {
+		first = &sock->packet_sizes[sock->packet_head];
+
+		/* handle partial read */
+		if (len < *first) {
+			*first -= len;
+			sock->packet_total -= len;
+			break;
+		}
+
+		len -= *first;
+		modem_socket_packet_drop_first(sock);
+	}
+}
+
 int modem_socket_packet_size_update(struct modem_socket_config *cfg, struct modem_socket *sock,
 				    int new_total)
 {
-	uint16_t old_total = 0U;
+	k_spinlock_key_t key;
+	uint32_t old_total;
+	uint32_t diff;
+
+	ARG_UNUSED(cfg);
 
 	if (!sock) {
 		return -EINVAL;
 	}
 
-	k_sem_take(&cfg->sem_lock, K_FOREVER);
+	key = k_spin_lock(&sock->lock);
 
 	if (new_total < 0) {
-		new_total += modem_socket_packet_get_total(sock);
+		new_total += sock->packet_total;
 	}
 
 	if (new_total <= 0) {
 		/* reset outstanding value here */
-		sock->packet_count = 0U;
-		sock->packet_sizes[0] = 0U;
-		k_poll_signal_reset(&sock->sig_data_ready);
-		k_sem_give(&cfg->sem_lock);
+		modem_socket_packet_reset(sock);
+		modem_socket_data_ready_signal(sock);
+		k_spin_unlock(&sock->lock, key);
 		return 0;
 	}
 
-	old_total = modem_socket_packet_get_total(sock);
+	old_total = sock->packet_total;
 	if (new_total == old_total) {
 		goto data_ready;
 	}
 
 	/* remove sent packets */
 	if (new_total < old_total) {
-		/* remove packets that are not included in new_size */
-		while (old_total > new_total && sock->packet_count > 0) {
-			/* handle partial read */
-			if (old_total - new_total < sock->packet_sizes[0]) {
-				sock->packet_sizes[0] -= old_total - new_total;
-				break;
-			}
-
-			old_total -= sock->packet_sizes[0];
-			modem_socket_packet_drop_first(sock);
-		}
-
+		modem_socket_packet_consume(sock, old_total - new_total);
 		goto data_ready;
 	}
 
-	/* new packet to add */
-	if (sock->packet_count >= CONFIG_MODEM_SOCKET_PACKET_COUNT) {
-		k_sem_give(&cfg->sem_lock);
+	/* new packet to add, larger ones take several entries */
+	diff = new_total - old_total;
+	if (sock->packet_count + DIV_ROUND_UP(diff, UINT16_MAX) >
+	    CONFIG_MGSM_MODEM_SOCKET_PACKET_COUNT) {
+		k_spin_unlock(&sock->lock, key);
 		return -ENOMEM;
 	}
 
-	if (new_total - old_total > 0) {
-		sock->packet_sizes[sock->packet_count] = new_total - old_total;
-		sock->packet_count++;
-	} else {
-		k_sem_give(&cfg->sem_lock);
-		return -EINVAL;
+	while (diff > 0) {
+		uint16_t size = MIN(diff, UINT16_MAX);
+
+		modem_socket_packet_push(sock, size);
+		diff -= size;
 	}
 
 data_ready:
-	if (sock->packet_sizes[0]) {
-		k_poll_signal_raise(&sock->sig_data_ready, 0);
+	modem_socket_data_ready_signal(sock);
+	k_spin_unlock(&sock->lock, key);
+	return new_total;
+}
+
+/*
+ * Receive Cache Support Functions
+ */
+
+size_t modem_socket_rx_cache_read(struct modem_socket_config *cfg, struct modem_socket *sock,
+				  void *buf, size_t len)
+{
+#if defined(CONFIG_MGSM_MODEM_SOCKET_RX_CACHE)
+	k_spinlock_key_t key;
+	size_t ret;
+
+	ARG_UNUSED(cfg);
+
+	if (!sock || sock->type != SOCK_STREAM) {
+		return 0;
+	}
+
+	key = k_spin_lock(&sock->lock);
+
+	ret = ring_buf_get(&sock->rx_cache, buf, len);
+	if (ret) {
+		sock->rx_cache_hits++;
+		modem_socket_data_ready_signal(sock);
 	} else {
-		k_poll_signal_reset(&sock->sig_data_ready);
+		sock->rx_cache_misses++;
 	}
-	k_sem_give(&cfg->sem_lock);
-	return new_total;
+
+	k_spin_unlock(&sock->lock, key);
+	return ret;
+#else
+	ARG_UNUSED(cfg);
+	ARG_UNUSED(sock);
+	ARG_UNUSED(buf);
+	ARG_UNUSED(len);
+
+	return 0;
+#endif
+}
+
+size_t modem_socket_rx_cache_fill_len(struct modem_socket_config *cfg,
+				      struct modem_socket *sock)
+{
+#if defined(CONFIG_MGSM_MODEM_SOCKET_RX_CACHE)
+	k_spinlock_key_t key;
+	size_t ret;
+
+	ARG_UNUSED(cfg);
+
+	if (!sock || sock->type != SOCK_STREAM) {
+		return 0;
+	}
+
+	key = k_spin_lock(&sock->lock);
+	ret = MIN(ring_buf_space_get(&sock->rx_cache), sock->packet_total);
+	k_spin_unlock(&sock->lock, key);
+
+	return ret;
+#else
+	ARG_UNUSED(cfg);
+	ARG_UNUSED(sock);
+
+	return 0;
+#endif
+}
+
+int modem_socket_rx_cache_fill(struct modem_socket_config *cfg, struct modem_socket *sock,
+			       const void *data, size_t len)
+{
+#if defined(CONFIG_MGSM_MODEM_SOCKET_RX_CACHE)
+	k_spinlock_key_t key;
+
+	ARG_UNUSED(cfg);
+
+	if (!sock || sock->type != SOCK_STREAM) {
+		return -ENOTSUP;
+	}
+
+	key = k_spin_lock(&sock->lock);
+
+	if (ring_buf_space_get(&sock->rx_cache) < len) {
+		k_spin_unlock(&sock->lock, key);
+		return -ENOMEM;
+	}
+
+	ring_buf_put(&sock->rx_cache, data, len);
+	sock->rx_cache_fills++;
+
+	/* the data has left the modem */
+	modem_socket_packet_consume(sock, len);
+
+	modem_socket_data_ready_signal(sock);
+	k_spin_unlock(&sock->lock, key);
+	return 0;
+#else
+	ARG_UNUSED(cfg);
+	ARG_UNUSED(sock);
+	ARG_UNUSED(data);
+	ARG_UNUSED(len);
+
+	return -ENOTSUP;
+#endif
+}
+
+static void modem_socket_send_window_set(struct modem_socket *sock, uint32_t window)
+{
+	sock->send_window = window;
+
+	if (window) {
+		k_poll_signal_raise(&sock->sig_send_ready, 0);
+	} else {
+		k_poll_signal_reset(&sock->sig_send_ready);
+	}
+}
+
+void modem_socket_send_window_update(struct modem_socket_config *cfg, struct modem_socket *sock,
+				     uint32_t window)
+{
+	k_spinlock_key_t key;
+
+	ARG_UNUSED(cfg);
+
+	if (!sock) {
+		return;
+	}
+
+	key = k_spin_lock(&sock->lock);
+	modem_socket_send_window_set(sock, window);
+	k_spin_unlock(&sock->lock, key);
+}
+
+uint32_t modem_socket_send_window_consume(struct modem_socket_config *cfg,
+					  struct modem_socket *sock, size_t len)
+{
+	k_spinlock_key_t key;
+	uint32_t window;
+
+	ARG_UNUSED(cfg);
+
+	if (!sock) {
+		return 0U;
+	}
+
+	key = k_spin_lock(&sock->lock);
+
+	window = sock->send_window;
+	if (window != MODEM_SOCKET_SEND_WINDOW_NONE) {
+		window = len < window ? window - len : 0U;
+		modem_socket_send_window_set(sock, window);
+	}
+
+	k_spin_unlock(&sock->lock, key);
+	return window;
 }
 
 /*
@@ -173,8 +362,13 @@ int modem_socket_get(struct modem_socket_config *cfg, int family, int type, int
 	cfg->sockets[i].family = family;
 	cfg->sockets[i].type = type;
 	cfg->sockets[i].ip_proto = proto;
+	cfg->sockets[i].rcv_timeout = K_FOREVER;
 	cfg->sockets[i].id = (cfg->assign_id) ? (i + cfg->base_socket_id) :
 		(cfg->base_socket_id + cfg->sockets_len);
+	if (cfg->assign_id) {
+		cfg->id_map[i] = i;
+	}
+	cfg->fd_map[cfg->sockets[i].sock_fd] = i;
 	z_finalize_fd(cfg->sockets[i].sock_fd, &cfg->sockets[i],
 		      (const struct fd_op_vtable *)cfg->vtable);
 
@@ -182,32 +376,48 @@ int modem_socket_get(struct modem_socket_config *cfg, int family, int type, int
 	return cfg->sockets[i].sock_fd;
 }
 
+/*
+ * The maps are read without sem_lock. A slot is only used if the socket
+ * in it still has the fd or id looked up, which covers racing with
+ * modem_socket_put().
+ */
 struct modem_socket *modem_socket_from_fd(struct modem_socket_config *cfg, int sock_fd)
 {
-	int i;
+	int slot;
 
-	k_sem_take(&cfg->sem_lock, K_FOREVER);
-
-	for (i = 0; i < cfg->sockets_len; i++) {
-		if (cfg->sockets[i].sock_fd == sock_fd) {
-			k_sem_give(&cfg->sem_lock);
-			return &cfg->sockets[i];
-		}
+	if (sock_fd < 0 || sock_fd >= ARRAY_SIZE(cfg->fd_map)) {
+		return NULL;
 	}
 
-	k_sem_give(&cfg->sem_lock);
+	slot = cfg->fd_map[sock_fd];
+	if (slot < 0 || cfg->sockets[slot].sock_fd != sock_fd) {
+		return NULL;
+	}
 
-	return NULL;
+	return &cfg->sockets[slot];
 }
 
 struct modem_socket *modem_socket_from_id(struct modem_socket_config *cfg, int id)
 {
+	int slot;
 	int i;
 
 	if (id < cfg->base_socket_id) {
 		return NULL;
 	}
 
+	if (id < cfg->base_socket_id + cfg->sockets_len) {
+		slot = cfg->id_map[id - cfg->base_socket_id];
+		if (slot < 0 || cfg->sockets[slot].id != id) {
+			return NULL;
+		}
+
+		return &cfg->sockets[slot];
+	}
+
+	/* Sockets waiting for an id share the reserved one, see
+	 * modem_socket_from_newid()
+	 */
 	k_sem_take(&cfg->sem_lock, K_FOREVER);
 
 	for (i = 0; i < cfg->sockets_len; i++) {
@@ -230,6 +440,7 @@ struct modem_socket *modem_socket_from_newid(struct modem_socket_config *cfg)
 void modem_socket_put(struct modem_socket_config *cfg, int sock_fd)
 {
 	struct modem_socket *sock = modem_socket_from_fd(cfg, sock_fd);
+	k_spinlock_key_t key;
 
 	if (!sock) {
 		return;
@@ -237,16 +448,37 @@ void modem_socket_put(struct modem_socket_config *cfg, int sock_fd)
 
 	k_sem_take(&cfg->sem_lock, K_FOREVER);
 
+	if (modem_socket_id_is_assigned(cfg, sock)) {
+		cfg->id_map[sock->id - cfg->base_socket_id] = -1;
+	}
+	cfg->fd_map[sock_fd] = -1;
+
 	sock->id = cfg->base_socket_id - 1;
 	sock->sock_fd = -1;
-	sock->is_waiting = false;
 	sock->is_connected = false;
 	(void)memset(&sock->src, 0, sizeof(struct sockaddr));
 	(void)memset(&sock->dst, 0, sizeof(struct sockaddr));
+
+	key = k_spin_lock(&sock->lock);
+	sock->is_waiting = false;
 	memset(&sock->packet_sizes, 0, sizeof(sock->packet_sizes));
-	sock->packet_count = 0;
+	modem_socket_packet_reset(sock);
+#if defined(CONFIG_MGSM_MODEM_SOCKET_RX_CACHE)
+	ring_buf_reset(&sock->rx_cache);
+	sock->rx_cache_hits = 0U;
+	sock->rx_cache_misses = 0U;
+	sock->rx_cache_fills = 0U;
+#endif
+#if defined(CONFIG_MGSM_MODEM_SOCKET_WAKE_LATENCY)
+	sock->wake_cycles = 0U;
+	sock->wake_count = 0U;
+	sock->wake_total_us = 0U;
+	sock->wake_max_us = 0U;
+#endif
 	k_sem_reset(&sock->sem_data_ready);
 	k_poll_signal_reset(&sock->sig_data_ready);
+	modem_socket_send_window_set(sock, MODEM_SOCKET_SEND_WINDOW_NONE);
+	k_spin_unlock(&sock->lock, key);
 
 	k_sem_give(&cfg->sem_lock);
 }
@@ -268,30 +500,34 @@ int modem_socket_poll(struct modem_socket_config *cfg, struct zsock_pollfd *fds,
 	struct modem_socket *sock;
 	int ret, i;
 	uint8_t found_count = 0;
+	short ready;
 
 	if (!cfg || nfds > CONFIG_NET_SOCKETS_POLL_MAX) {
 		return -EINVAL;
 	}
-	struct k_poll_event events[nfds];
+	struct k_poll_event events[nfds * 2];
 	int eventcount = 0;
 
+	/* Every fd needs its events set up, k_poll() is skipped if one is ready */
 	for (i = 0; i < nfds; i++) {
 		sock = modem_socket_from_fd(cfg, fds[i].fd);
-		if (sock) {
-			/*
-			 * Handle user check for POLLOUT events:
-			 * we consider the socket to always be writable.
-			 */
-			if (fds[i].events & ZSOCK_POLLOUT) {
+		if (!sock) {
+			continue;
+		}
+
+		if (fds[i].events & ZSOCK_POLLIN) {
+			k_poll_event_init(&events[eventcount++], K_POLL_TYPE_SIGNAL,
+					  K_POLL_MODE_NOTIFY_ONLY, &sock->sig_data_ready);
+			if (modem_socket_rx_pending(sock)) {
+				found_count++;
+			}
+		}
+
+		if (fds[i].events & ZSOCK_POLLOUT) {
+			k_poll_event_init(&events[eventcount++], K_POLL_TYPE_SIGNAL,
+					  K_POLL_MODE_NOTIFY_ONLY, &sock->sig_send_ready);
+			if (sock->send_window > 0U) {
 				found_count++;
-				break;
-			} else if (fds[i].events & ZSOCK_POLLIN) {
-				k_poll_event_init(&events[eventcount++], K_POLL_TYPE_SIGNAL,
-						  K_POLL_MODE_NOTIFY_ONLY, &sock->sig_data_ready);
-				if (sock->packet_sizes[0] > 0U) {
-					found_count++;
-					break;
-				}
 			}
 		}
 	}
@@ -315,15 +551,17 @@ int modem_socket_poll(struct modem_socket_config *cfg, struct zsock_pollfd *fds,
 			continue;
 		}
 
-		/*
-		 * Handle user check for ZSOCK_POLLOUT events:
-		 * we consider the socket to always be writable.
-		 */
-		if (fds[i].events & ZSOCK_POLLOUT) {
-			fds[i].revents |= ZSOCK_POLLOUT;
-			found_count++;
-		} else if ((fds[i].events & ZSOCK_POLLIN) && (sock->packet_sizes[0] > 0U)) {
-			fds[i].revents |= ZSOCK_POLLIN;
+		ready = 0;
+		if ((fds[i].events & ZSOCK_POLLIN) && modem_socket_rx_pending(sock)) {
+			ready |= ZSOCK_POLLIN;
+		}
+
+		if ((fds[i].events & ZSOCK_POLLOUT) && (sock->send_window > 0U)) {
+			ready |= ZSOCK_POLLOUT;
+		}
+
+		if (ready) {
+			fds[i].revents |= ready;
 			found_count++;
 		}
 	}
@@ -358,9 +596,10 @@ int modem_socket_poll_prepare(struct modem_socket_config *cfg, struct modem_sock
 			errno = ENOMEM;
 			return -1;
 		}
-		/* Not Implemented */
-		errno = ENOTSUP;
-		return -1;
+
+		k_poll_event_init(*pev, K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY,
+				  &sock->sig_send_ready);
+		(*pev)++;
 	}
 
 	return 0;
@@ -379,36 +618,176 @@ int modem_socket_poll_update(struct modem_socket *sock, struct zsock_pollfd *pfd
 	}
 
 	if (pfd->events & ZSOCK_POLLOUT) {
-		/* Not implemented, but the modem socket is always ready to transmit,
-		 * so set the revents
-		 */
-		pfd->revents |= ZSOCK_POLLOUT;
+		if ((*pev)->state != K_POLL_STATE_NOT_READY) {
+			pfd->revents |= ZSOCK_POLLOUT;
+		}
 		(*pev)++;
 	}
 
 	return 0;
 }
 
-void modem_socket_wait_data(struct modem_socket_config *cfg, struct modem_socket *sock)
+void modem_socket_wait_prepare(struct modem_socket_config *cfg, struct modem_socket *sock)
 {
-	k_sem_take(&cfg->sem_lock, K_FOREVER);
+	k_spinlock_key_t key;
+
+	ARG_UNUSED(cfg);
+
+	key = k_spin_lock(&sock->lock);
 	sock->is_waiting = true;
-	k_sem_give(&cfg->sem_lock);
+	/* a wake-up from before the data check is stale */
+	k_sem_reset(&sock->sem_data_ready);
+	k_spin_unlock(&sock->lock, key);
+}
+
+int modem_socket_wait_data(struct modem_socket_config *cfg, struct modem_socket *sock,
+			   k_timeout_t timeout)
+{
+	k_spinlock_key_t key;
+
+	ARG_UNUSED(cfg);
+
+	if (k_sem_take(&sock->sem_data_ready, timeout) == 0) {
+		return 0;
+	}
+
+	/* a data ready racing with this is seen by the next prepare */
+	key = k_spin_lock(&sock->lock);
+	sock->is_waiting = false;
+	k_spin_unlock(&sock->lock, key);
+
+	return -EAGAIN;
+}
+
+void modem_socket_wait_done(struct modem_socket_config *cfg, struct modem_socket *sock)
+{
+	k_spinlock_key_t key;
+
+	ARG_UNUSED(cfg);
 
-	k_sem_take(&sock->sem_data_ready, K_FOREVER);
+	key = k_spin_lock(&sock->lock);
+
+	sock->is_waiting = false;
+
+#if defined(CONFIG_MGSM_MODEM_SOCKET_WAKE_LATENCY)
+	if (sock->wake_cycles != 0U) {
+		uint32_t us = k_cyc_to_us_floor32(k_cycle_get_32() - sock->wake_cycles);
+
+		sock->wake_cycles = 0U;
+		sock->wake_count++;
+		sock->wake_total_us += us;
+		sock->wake_max_us = MAX(sock->wake_max_us, us);
+	}
+#endif
+
+	k_spin_unlock(&sock->lock, key);
 }
 
 void modem_socket_data_ready(struct modem_socket_config *cfg, struct modem_socket *sock)
 {
-	k_sem_take(&cfg->sem_lock, K_FOREVER);
+	k_spinlock_key_t key;
+
+	ARG_UNUSED(cfg);
+
+	key = k_spin_lock(&sock->lock);
 
 	if (sock->is_waiting) {
 		/* unblock sockets waiting on recv() */
 		sock->is_waiting = false;
+#if defined(CONFIG_MGSM_MODEM_SOCKET_WAKE_LATENCY)
+		/* 0 means accounted */
+		sock->wake_cycles = k_cycle_get_32() | 1U;
+#endif
 		k_sem_give(&sock->sem_data_ready);
 	}
 
-	k_sem_give(&cfg->sem_lock);
+	k_spin_unlock(&sock->lock, key);
+}
+
+int modem_socket_rcv_timeout_set(struct modem_socket *sock, const void *optval,
+				 socklen_t optlen)
+{
+	const struct zsock_timeval *tv = optval;
+
+	if (!sock || !tv || optlen != sizeof(*tv) || tv->tv_sec < 0 || tv->tv_usec < 0 ||
+	    tv->tv_usec >= USEC_PER_SEC) {
+		return -EINVAL;
+	}
+
+	/* no timeout, as for native sockets */
+	if (tv->tv_sec == 0 && tv->tv_usec == 0) {
+		sock->rcv_timeout = K_FOREVER;
+	} else {
+		sock->rcv_timeout = K_USEC((int64_t)tv->tv_sec * USEC_PER_SEC + tv->tv_usec);
+	}
+
+	return 0;
+}
+
+int modem_socket_wake_latency_get(struct modem_socket *sock,
+				  struct modem_socket_wake_latency *latency)
+{
+#if defined(CONFIG_MGSM_MODEM_SOCKET_WAKE_LATENCY)
+	k_spinlock_key_t key;
+
+	if (!sock || !latency) {
+		return -EINVAL;
+	}
+
+	key = k_spin_lock(&sock->lock);
+	latency->count = sock->wake_count;
+	latency->avg_us = sock->wake_count ? sock->wake_total_us / sock->wake_count : 0U;
+	latency->max_us = sock->wake_max_us;
+	k_spin_unlock(&sock->lock, key);
+
+	return 0;
+#else
+	ARG_UNUSED(sock);
+	ARG_UNUSED(latency);
+
+	return -ENOTSUP;
+#endif
+}
+
+int modem_socket_rx_cache_stats_get(struct modem_socket *sock,
+				    struct modem_socket_rx_cache_stats *stats)
+{
+#if defined(CONFIG_MGSM_MODEM_SOCKET_RX_CACHE)
+	k_spinlock_key_t key;
+
+	if (!sock || !stats) {
+		return -EINVAL;
+	}
+
+	key = k_spin_lock(&sock->lock);
+	stats->hits = sock->rx_cache_hits;
+	stats->misses = sock->rx_cache_misses;
+	stats->fills = sock->rx_cache_fills;
+	stats->used = ring_buf_size_get(&sock->rx_cache);
+	k_spin_unlock(&sock->lock, key);
+
+	return 0;
+#else
+	ARG_UNUSED(sock);
+	ARG_UNUSED(stats);
+
+	return -ENOTSUP;
+#endif
+}
+
+void modem_socket_foreach(modem_socket_foreach_cb_t cb, void *user_data)
+{
+	struct modem_socket_config *cfg;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&modem_socket_configs, cfg, node) {
+		k_sem_take(&cfg->sem_lock, K_FOREVER);
+		for (int i = 0; i < cfg->sockets_len; i++) {
+			if (modem_socket_is_allocated(cfg, &cfg->sockets[i])) {
+				cb(cfg, &cfg->sockets[i], user_data);
+			}
+		}
+		k_sem_give(&cfg->sem_lock);
+	}
 }
 
 int modem_socket_init(struct modem_socket_config *cfg, struct modem_socket *sockets,
@@ -416,7 +795,8 @@ int modem_socket_init(struct modem_socket_config *cfg, struct modem_socket *sock
 		      const struct socket_op_vtable *vtable)
 {
 	/* Verify arguments */
-	if (cfg == NULL || sockets == NULL || sockets_len < 1 || vtable == NULL) {
+	if (cfg == NULL || sockets == NULL || sockets_len < 1 || vtable == NULL ||
+	    sockets_len > CONFIG_MGSM_MODEM_SOCKET_MAX_SOCKETS) {
 		return -EINVAL;
 	}
 
@@ -427,6 +807,8 @@ int modem_socket_init(struct modem_socket_config *cfg, struct modem_socket *sock
 	cfg->assign_id = assign_id;
 	k_sem_init(&cfg->sem_lock, 1, 1);
 	cfg->vtable = vtable;
+	memset(cfg->fd_map, -1, sizeof(cfg->fd_map));
+	memset(cfg->id_map, -1, sizeof(cfg->id_map));
 
 	/* Initialize associated sockets */
 	for (int i = 0; i < cfg->sockets_len; i++) {
@@ -436,8 +818,19 @@ int modem_socket_init(struct modem_socket_config *cfg, struct modem_socket *sock
 		/* Initialize socket members */
 		k_sem_init(&cfg->sockets[i].sem_data_ready, 0, 1);
 		k_poll_signal_init(&cfg->sockets[i].sig_data_ready);
+		k_poll_signal_init(&cfg->sockets[i].sig_send_ready);
+#if defined(CONFIG_MGSM_MODEM_SOCKET_RX_CACHE)
+		ring_buf_init(&cfg->sockets[i].rx_cache, sizeof(cfg->sockets[i].rx_cache_buf),
+			      cfg->sockets[i].rx_cache_buf);
+#endif
+		modem_socket_send_window_set(&cfg->sockets[i], MODEM_SOCKET_SEND_WINDOW_NONE);
 		cfg->sockets[i].id = -1;
 	}
+
+	/* Initializing a config again must not add it twice */
+	(void)sys_slist_find_and_remove(&modem_socket_configs, &cfg->node);
+	sys_slist_append(&modem_socket_configs, &cfg->node);
+
 	return 0;
 }
 
@@ -464,7 +857,7 @@ bool modem_socket_id_is_assigned(const struct modem_socket_config *cfg,
 	return false;
 }
 
-int modem_socket_id_assign(const struct modem_socket_config *cfg,
+int modem_socket_id_assign(struct modem_socket_config *cfg,
 			   struct modem_socket *sock, int id)
 {
 	/* Verify dynamically assigning id is disabled */
@@ -484,5 +877,6 @@ int modem_socket_id_assign(const struct modem_socket_config *cfg,
 
 	/* Assign id */
 	sock->id = id;
+	cfg->id_map[id - cfg->base_socket_id] = sock - cfg->sockets;
 	return 0;
 }
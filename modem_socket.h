@@ -16,6 +16,7 @@
 #include <zephyr/kernel.h>
 #include <zephyr/net/net_ip.h>
 #include <zephyr/net/socket.h>
+#include <zephyr/sys/ring_buffer.h>
 
 #include "sockets_internal.h"
 
@@ -23,6 +24,9 @@
 extern "C" {
 #endif
 
+/* send window of sockets whose driver does not report one */
+#define MODEM_SOCKET_SEND_WINDOW_NONE UINT32_MAX
+
 __net_socket struct modem_socket {
 	sa_family_t family;
 	enum net_sock_type type;
@@ -36,14 +40,48 @@ __net_socket struct modem_socket {
 	/** The file descriptor identifying the socket in the fdtable */
 	int sock_fd;
 
-	/** packet data */
-	uint16_t packet_sizes[CONFIG_MODEM_SOCKET_PACKET_COUNT];
+	/** protects the packet data and the wait state */
+	struct k_spinlock lock;
+
+	/** packet data, a circular queue starting at packet_head */
+	uint16_t packet_sizes[CONFIG_MGSM_MODEM_SOCKET_PACKET_COUNT];
+	uint16_t packet_head;
 	uint16_t packet_count;
+	/** sum of packet_sizes */
+	uint32_t packet_total;
 
 	/** data ready semaphore */
 	struct k_sem sem_data_ready;
 	/** data ready poll signal */
 	struct k_poll_signal sig_data_ready;
+	/** recv() wait timeout, K_FOREVER unless set with SO_RCVTIMEO */
+	k_timeout_t rcv_timeout;
+
+	/** bytes the modem can still take, MODEM_SOCKET_SEND_WINDOW_NONE if not tracked */
+	uint32_t send_window;
+	/** send ready poll signal, raised while send_window is not 0 */
+	struct k_poll_signal sig_send_ready;
+
+#if defined(CONFIG_MGSM_MODEM_SOCKET_RX_CACHE)
+	/** data already read from the modem, stream sockets only */
+	struct ring_buf rx_cache;
+	uint8_t rx_cache_buf[CONFIG_MGSM_MODEM_SOCKET_RX_CACHE_SIZE];
+	/** reads served from the cache, fully or partly */
+	uint32_t rx_cache_hits;
+	/** reads that found the cache empty */
+	uint32_t rx_cache_misses;
+	/** modem reads stored in the cache */
+	uint32_t rx_cache_fills;
+#endif
+
+#if defined(CONFIG_MGSM_MODEM_SOCKET_WAKE_LATENCY)
+	/** cycle count of the last wake-up by data ready, 0 once accounted */
+	uint32_t wake_cycles;
+	/** wake-ups accounted, their total and maximum latency */
+	uint32_t wake_count;
+	uint64_t wake_total_us;
+	uint32_t wake_max_us;
+#endif
 
 	/** socket state */
 	bool is_connected;
@@ -53,6 +91,25 @@ __net_socket struct modem_socket {
 	void *data;
 };
 
+/** Data ready to recv() return latency of a modem socket */
+struct modem_socket_wake_latency {
+	uint32_t count;
+	uint32_t avg_us;
+	uint32_t max_us;
+};
+
+/** Receive cache counters of a modem socket */
+struct modem_socket_rx_cache_stats {
+	/** recv() calls served from the cache */
+	uint32_t hits;
+	/** recv() calls that found the cache empty */
+	uint32_t misses;
+	/** reads from the modem into the cache */
+	uint32_t fills;
+	/** bytes in the cache */
+	uint32_t used;
+};
+
 struct modem_socket_config {
 	struct modem_socket *sockets;
 	size_t sockets_len;
@@ -63,11 +120,30 @@ struct modem_socket_config {
 	/* dynamically assign id when modem socket is allocated */
 	bool assign_id;
 
+	/* protects socket allocation and free, packet state uses sock->lock */
 	struct k_sem sem_lock;
 
+	/* socket slot by fd and by (id - base_socket_id), -1 if none */
+	int8_t fd_map[CONFIG_POSIX_MAX_FDS];
+	int8_t id_map[CONFIG_MGSM_MODEM_SOCKET_MAX_SOCKETS];
+
 	const struct socket_op_vtable *vtable;
+
+	/* entry in the list of configs walked by modem_socket_foreach() */
+	sys_snode_t node;
 };
 
+/**
+ * @typedef modem_socket_foreach_cb_t
+ * @brief Callback of modem_socket_foreach()
+ *
+ * @param cfg The modem socket config which the modem socket belongs to
+ * @param sock An allocated modem socket
+ * @param user_data User data passed to modem_socket_foreach()
+ */
+typedef void (*modem_socket_foreach_cb_t)(struct modem_socket_config *cfg,
+					  struct modem_socket *sock, void *user_data);
+
 /* return size of the first packet */
 uint16_t modem_socket_next_packet_size(struct modem_socket_config *cfg, struct modem_socket *sock);
 int modem_socket_packet_size_update(struct modem_socket_config *cfg, struct modem_socket *sock,
@@ -84,9 +160,222 @@ int modem_socket_poll_update(struct modem_socket *sock, struct zsock_pollfd *pfd
 int modem_socket_poll_prepare(struct modem_socket_config *cfg, struct modem_socket *sock,
 			      struct zsock_pollfd *pfd, struct k_poll_event **pev,
 			      struct k_poll_event *pev_end);
-void modem_socket_wait_data(struct modem_socket_config *cfg, struct modem_socket *sock);
 void modem_socket_data_ready(struct modem_socket_config *cfg, struct modem_socket *sock);
 
+/**
+ * @brief Announce a wait for data on a modem socket
+ *
+ * @details Called by recv() before checking for data, so that a
+ * modem_socket_data_ready() between the check and modem_socket_wait_data()
+ * is not lost.
+ *
+ * @param cfg The modem socket config which the modem socket belongs to
+ * @param sock The modem socket
+ */
+void modem_socket_wait_prepare(struct modem_socket_config *cfg, struct modem_socket *sock);
+
+/**
+ * @brief Wait for data on a modem socket
+ *
+ * @details Returns once modem_socket_data_ready() is called after
+ * modem_socket_wait_prepare(). With K_NO_WAIT it only checks if that
+ * already happened, which is the non-blocking variant.
+ *
+ * @param cfg The modem socket config which the modem socket belongs to
+ * @param sock The modem socket
+ * @param timeout Maximum time to wait, e.g. modem_socket_recv_timeout()
+ *
+ * @return 0 if data ready was signaled
+ * @return -EAGAIN if it was not, within timeout
+ */
+int modem_socket_wait_data(struct modem_socket_config *cfg, struct modem_socket *sock,
+			   k_timeout_t timeout);
+
+/**
+ * @brief End the wait of recv() on a modem socket
+ *
+ * @details Called by recv() before returning data. Accounts the wake-up
+ * latency if CONFIG_MGSM_MODEM_SOCKET_WAKE_LATENCY is enabled.
+ *
+ * @param cfg The modem socket config which the modem socket belongs to
+ * @param sock The modem socket
+ */
+void modem_socket_wait_done(struct modem_socket_config *cfg, struct modem_socket *sock);
+
+/**
+ * @brief Get the recv() wait timeout of a modem socket
+ *
+ * @param sock The modem socket
+ * @param flags recv() flags
+ *
+ * @return K_NO_WAIT for ZSOCK_MSG_DONTWAIT, the SO_RCVTIMEO timeout otherwise
+ */
+static inline k_timeout_t modem_socket_recv_timeout(const struct modem_socket *sock, int flags)
+{
+	return (flags & ZSOCK_MSG_DONTWAIT) ? K_NO_WAIT : sock->rcv_timeout;
+}
+
+/**
+ * @brief Set the recv() wait timeout of a modem socket from SO_RCVTIMEO
+ *
+ * @param sock The modem socket
+ * @param optval struct zsock_timeval, all zero for no timeout
+ * @param optlen Size of optval
+ *
+ * @return -EINVAL if optval is not a valid timeout
+ * @return 0 if successful
+ */
+int modem_socket_rcv_timeout_set(struct modem_socket *sock, const void *optval,
+				 socklen_t optlen);
+
+/**
+ * @brief Get the data ready to recv() return latency of a modem socket
+ *
+ * @param sock The modem socket
+ * @param latency Destination of the latency since the socket was allocated
+ *
+ * @return -ENOTSUP if CONFIG_MGSM_MODEM_SOCKET_WAKE_LATENCY is disabled
+ * @return 0 if successful
+ */
+int modem_socket_wake_latency_get(struct modem_socket *sock,
+				  struct modem_socket_wake_latency *latency);
+
+/**
+ * @brief Get the receive cache counters of a modem socket
+ *
+ * @param sock The modem socket
+ * @param stats Destination of the counters since the socket was allocated
+ *
+ * @return -ENOTSUP if CONFIG_MGSM_MODEM_SOCKET_RX_CACHE is disabled
+ * @return -EINVAL if any argument is NULL
+ * @return 0 if successful
+ */
+int modem_socket_rx_cache_stats_get(struct modem_socket *sock,
+				    struct modem_socket_rx_cache_stats *stats);
+
+/**
+ * @brief Call a function for each allocated modem socket
+ *
+ * @details Walks the sockets of every config passed to modem_socket_init(),
+ * e.g. for shell output.
+ *
+ * @param cb Function to call
+ * @param user_data User data passed to cb
+ */
+void modem_socket_foreach(modem_socket_foreach_cb_t cb, void *user_data);
+
+/**
+ * @brief Set the send window of a modem socket
+ *
+ * @details Called by the driver with the free TX buffer space the modem
+ * reports for the socket, e.g. in a send acknowledgement. POLLOUT is
+ * reported while the window is not 0. Until the first update the socket
+ * is always writable.
+ *
+ * @param cfg The modem socket config which the modem socket belongs to
+ * @param sock The modem socket
+ * @param window Bytes the modem can take, or MODEM_SOCKET_SEND_WINDOW_NONE
+ *        to stop tracking
+ */
+void modem_socket_send_window_update(struct modem_socket_config *cfg, struct modem_socket *sock,
+				     uint32_t window);
+
+/**
+ * @brief Take sent data off the send window of a modem socket
+ *
+ * @details Called by the driver after handing len bytes to the modem, so that
+ * POLLOUT clears before the next free buffer report arrives.
+ *
+ * @param cfg The modem socket config which the modem socket belongs to
+ * @param sock The modem socket
+ * @param len Bytes sent
+ *
+ * @return The remaining send window
+ */
+uint32_t modem_socket_send_window_consume(struct modem_socket_config *cfg,
+					  struct modem_socket *sock, size_t len);
+
+/**
+ * @brief Read from the receive cache of a modem socket
+ *
+ * @details recv() of drivers using the cache calls this first and only
+ * reads from the modem if it returns 0.
+ *
+ * @param cfg The modem socket config which the modem socket belongs to
+ * @param sock The modem socket
+ * @param buf Destination buffer
+ * @param len Size of buf
+ *
+ * @return Number of bytes copied to buf, 0 if the cache is empty or disabled
+ */
+size_t modem_socket_rx_cache_read(struct modem_socket_config *cfg, struct modem_socket *sock,
+				  void *buf, size_t len);
+
+/**
+ * @brief Get the size of the next read to fill the receive cache
+ *
+ * @details On a data ready URC, drivers using the cache read this many bytes
+ * from the modem in one go and hand them to modem_socket_rx_cache_fill().
+ * It is the smaller of the free cache space and the data waiting in the
+ * modem.
+ *
+ * @param cfg The modem socket config which the modem socket belongs to
+ * @param sock The modem socket
+ *
+ * @return Bytes to read, 0 if the cache is full, disabled or the socket is
+ *         not a stream socket
+ */
+size_t modem_socket_rx_cache_fill_len(struct modem_socket_config *cfg,
+				      struct modem_socket *sock);
+
+/**
+ * @brief Store data read from the modem in the receive cache
+ *
+ * @details The data is taken off the packet sizes of the socket, as it is
+ * no longer waiting in the modem.
+ *
+ * @param cfg The modem socket config which the modem socket belongs to
+ * @param sock The modem socket
+ * @param data Data read from the modem
+ * @param len Length of data
+ *
+ * @return -ENOTSUP if the cache is disabled or the socket is not a stream socket
+ * @return -ENOMEM if data does not fit in the cache
+ * @return 0 if successful
+ */
+int modem_socket_rx_cache_fill(struct modem_socket_config *cfg, struct modem_socket *sock,
+			       const void *data, size_t len);
+
+/**
+ * @brief Get the number of bytes a modem socket can return without reading the modem
+ *
+ * @param sock The modem socket
+ *
+ * @return Bytes in the receive cache, 0 if the cache is disabled
+ */
+static inline size_t modem_socket_rx_cache_len(struct modem_socket *sock)
+{
+#if defined(CONFIG_MGSM_MODEM_SOCKET_RX_CACHE)
+	return ring_buf_size_get(&sock->rx_cache);
+#else
+	ARG_UNUSED(sock);
+
+	return 0;
+#endif
+}
+
+/**
+ * @brief Get the send window of a modem socket
+ *
+ * @param sock The modem socket
+ *
+ * @return Bytes the modem can take, MODEM_SOCKET_SEND_WINDOW_NONE if not tracked
+ */
+static inline uint32_t modem_socket_send_window(const struct modem_socket *sock)
+{
+	return sock->send_window;
+}
+
 /**
  * @brief Initialize modem socket config struct and associated modem sockets
  *
@@ -97,7 +386,8 @@ void modem_socket_data_ready(struct modem_socket_config *cfg, struct modem_socke
  * @param assign_id Dynamically assign modem socket id when allocated using modem_socket_get()
  * @param vtable Socket API implementation used by this config and associated sockets
  *
- * @return -EINVAL if any argument is invalid
+ * @return -EINVAL if any argument is invalid, or sockets_len is above
+ *         CONFIG_MGSM_MODEM_SOCKET_MAX_SOCKETS
  * @return 0 if successful
  */
 int modem_socket_init(struct modem_socket_config *cfg, struct modem_socket *sockets,
@@ -149,7 +439,7 @@ bool modem_socket_id_is_assigned(const struct modem_socket_config *cfg,
  * @return -EINVAL if id is invalid
  * @return 0 if successful
  */
-int modem_socket_id_assign(const struct modem_socket_config *cfg,
+int modem_socket_id_assign(struct modem_socket_config *cfg,
 			   struct modem_socket *sock,
 			   int id);
 
@@ -0,0 +1,165 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Lock contention benchmark for the modem socket packet state. N threads
+ * run the calls done by the modem RX thread and by recv() for each packet:
+ * a packet size update, data ready, next packet size and the update after
+ * the read. Either every thread has its own socket or all threads share
+ * one, which shows what concurrent traffic on several sockets costs. The
+ * baseline mode also takes one semaphore around every call, the way the
+ * config wide lock did before the sockets had their own. Only meaningful
+ * on SMP targets, on a single CPU the threads never overlap.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(modem_socket_bench, CONFIG_MODEM_LOG_LEVEL);
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+#include <string.h>
+
+#include "modem_socket.h"
+#include "modem_socket_bench.h"
+
+#define BENCH_OPS_PER_ITERATION 4
+#define BENCH_PACKET_LEN        128
+
+static K_THREAD_STACK_ARRAY_DEFINE(bench_stacks,
+				   CONFIG_MGSM_MODEM_SOCKET_BENCHMARK_MAX_THREADS,
+				   CONFIG_MGSM_MODEM_SOCKET_BENCHMARK_STACK_SIZE);
+
+struct bench_thread {
+	struct k_thread thread;
+	struct modem_socket *sock;
+	uint32_t cycles;
+	uint32_t errors;
+};
+
+static const struct socket_op_vtable bench_vtable;
+
+static struct {
+	const struct modem_socket_bench_params *params;
+	struct modem_socket_config cfg;
+	struct modem_socket sockets[CONFIG_MGSM_MODEM_SOCKET_BENCHMARK_MAX_THREADS];
+	struct bench_thread threads[CONFIG_MGSM_MODEM_SOCKET_BENCHMARK_MAX_THREADS];
+	struct k_sem global_lock;
+	atomic_t busy;
+} bench;
+
+static inline void bench_lock(void)
+{
+	if (bench.params->global_lock) {
+		k_sem_take(&bench.global_lock, K_FOREVER);
+	}
+}
+
+static inline void bench_unlock(void)
+{
+	if (bench.params->global_lock) {
+		k_sem_give(&bench.global_lock);
+	}
+}
+
+static void bench_thread_fn(void *p1, void *p2, void *p3)
+{
+	struct bench_thread *t = p1;
+	struct modem_socket *sock = t->sock;
+	uint32_t start, i;
+	uint16_t len;
+
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	start = k_cycle_get_32();
+
+	for (i = 0; i < bench.params->iterations; i++) {
+		/* modem reports a packet */
+		bench_lock();
+		modem_socket_packet_size_update(&bench.cfg, sock, BENCH_PACKET_LEN);
+		bench_unlock();
+		bench_lock();
+		modem_socket_data_ready(&bench.cfg, sock);
+		bench_unlock();
+
+		/* recv() reads it */
+		bench_lock();
+		len = modem_socket_next_packet_size(&bench.cfg, sock);
+		bench_unlock();
+		bench_lock();
+		modem_socket_packet_size_update(&bench.cfg, sock, -BENCH_PACKET_LEN);
+		bench_unlock();
+
+		if (!bench.params->shared && len != BENCH_PACKET_LEN) {
+			t->errors++;
+		}
+	}
+
+	t->cycles = k_cycle_get_32() - start;
+}
+
+int modem_socket_bench_run(const struct modem_socket_bench_params *params,
+			   struct modem_socket_bench_result *result)
+{
+	int prio = k_thread_priority_get(k_current_get());
+	int64_t start;
+	uint32_t i;
+	int ret;
+
+	if (params->threads == 0 ||
+	    params->threads > CONFIG_MGSM_MODEM_SOCKET_BENCHMARK_MAX_THREADS) {
+		return -EINVAL;
+	}
+
+	if (!atomic_cas(&bench.busy, 0, 1)) {
+		return -EBUSY;
+	}
+
+	ret = modem_socket_init(&bench.cfg, bench.sockets,
+				params->shared ? 1 : params->threads, 0, true,
+				&bench_vtable);
+	if (ret < 0) {
+		LOG_ERR("Socket init failed (%d)", ret);
+		goto out;
+	}
+
+	bench.params = params;
+	k_sem_init(&bench.global_lock, 1, 1);
+	memset(result, 0, sizeof(*result));
+
+	for (i = 0; i < params->threads; i++) {
+		struct bench_thread *t = &bench.threads[i];
+
+		t->sock = &bench.sockets[params->shared ? 0 : i];
+		t->cycles = 0U;
+		t->errors = 0U;
+
+		k_thread_create(&t->thread, bench_stacks[i],
+				K_THREAD_STACK_SIZEOF(bench_stacks[i]),
+				bench_thread_fn, t, NULL, NULL, prio, 0,
+				K_FOREVER);
+		k_thread_name_set(&t->thread, "modem_socket_bench");
+	}
+
+	start = k_uptime_get();
+
+	for (i = 0; i < params->threads; i++) {
+		k_thread_start(&bench.threads[i].thread);
+	}
+
+	for (i = 0; i < params->threads; i++) {
+		struct bench_thread *t = &bench.threads[i];
+
+		k_thread_join(&t->thread, K_FOREVER);
+		result->cycles += t->cycles;
+		result->errors += t->errors;
+	}
+
+	result->elapsed_ms = (uint32_t)(k_uptime_get() - start);
+	result->ops = (uint64_t)params->threads * params->iterations *
+		      BENCH_OPS_PER_ITERATION;
+
+out:
+	atomic_set(&bench.busy, 0);
+	return ret;
+}
@@ -0,0 +1,20 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+struct modem_socket_bench_params {
+	uint32_t threads;
+	uint32_t iterations; /* per thread */
+	bool shared;         /* all threads use the same socket */
+	bool global_lock;    /* baseline, one lock around every call */
+};
+
+struct modem_socket_bench_result {
+	uint32_t elapsed_ms;
+	uint64_t ops;    /* socket calls, all threads */
+	uint64_t cycles; /* CPU cycles spent in the calls, all threads */
+	uint32_t errors; /* unexpected packet sizes, per socket mode only */
+};
+
+int modem_socket_bench_run(const struct modem_socket_bench_params *params,
+			   struct modem_socket_bench_result *result);